@@ -0,0 +1,209 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "texture_container.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <climits>
+
+// MaxRects bin packer (best short side fit). Keeps the list of maximal free
+// rectangles of a fixed size bin; every insert picks the free rectangle that
+// leaves the smallest leftover on its shorter side, then splits all free
+// rectangles the new one overlaps and prunes those contained in others.
+// No rotation, sprites keep their orientation.
+// ------------------------------------------------------------------------
+class MaxRectsPacker
+{
+public:
+    struct Rect
+    {
+        int x, y, width, height;
+    };
+
+    MaxRectsPacker(int width, int height)
+    {
+        freeRects.push_back({ 0, 0, width, height });
+    }
+
+    // place a width x height rect, false if it doesn't fit anywhere
+    bool insert(int width, int height, Rect &placed)
+    {
+        int bestShort = INT_MAX, bestLong = INT_MAX;
+        bool found = false;
+        for (const Rect &free : freeRects)
+        {
+            if (width > free.width || height > free.height)
+                continue;
+            int leftoverX = free.width - width, leftoverY = free.height - height;
+            int shortSide = std::min(leftoverX, leftoverY), longSide = std::max(leftoverX, leftoverY);
+            if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+            {
+                placed = { free.x, free.y, width, height };
+                bestShort = shortSide;
+                bestLong = longSide;
+                found = true;
+            }
+        }
+        if (!found)
+            return false;
+
+        std::vector<Rect> next;
+        for (const Rect &free : freeRects)
+            split(free, placed, next);
+        prune(next);
+        freeRects.swap(next);
+        return true;
+    }
+
+private:
+    std::vector<Rect> freeRects;
+
+    static bool overlaps(const Rect &a, const Rect &b)
+    {
+        return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+    }
+    static bool contains(const Rect &outer, const Rect &inner)
+    {
+        return inner.x >= outer.x && inner.y >= outer.y
+            && inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+    }
+    // the up to four maximal pieces of free that remain around used
+    static void split(const Rect &free, const Rect &used, std::vector<Rect> &out)
+    {
+        if (!overlaps(free, used))
+        {
+            out.push_back(free);
+            return;
+        }
+        if (used.x > free.x)
+            out.push_back({ free.x, free.y, used.x - free.x, free.height });
+        if (used.x + used.width < free.x + free.width)
+            out.push_back({ used.x + used.width, free.y, free.x + free.width - (used.x + used.width), free.height });
+        if (used.y > free.y)
+            out.push_back({ free.x, free.y, free.width, used.y - free.y });
+        if (used.y + used.height < free.y + free.height)
+            out.push_back({ free.x, used.y + used.height, free.width, free.y + free.height - (used.y + used.height) });
+    }
+    static void prune(std::vector<Rect> &rects)
+    {
+        for (size_t i = 0; i < rects.size(); i++)
+        {
+            for (size_t j = i + 1; j < rects.size(); j++)
+            {
+                if (contains(rects[j], rects[i]))
+                {
+                    rects.erase(rects.begin() + i);
+                    i--;
+                    break;
+                }
+                if (contains(rects[i], rects[j]))
+                {
+                    rects.erase(rects.begin() + j);
+                    j--;
+                }
+            }
+        }
+    }
+};
+
+// one image inside an atlas. x/y/width/height are the image's own texels
+// (gutters excluded); uvMin/uvMax are the same rectangle in atlas UV space.
+struct AtlasRegion
+{
+    std::string name;
+    int x, y, width, height;
+    glm::vec2 uvMin;
+    glm::vec2 uvMax;
+
+    // map a 0..1 UV of the original image into the atlas
+    glm::vec2 remap(const glm::vec2 &uv) const
+    {
+        return glm::vec2(uvMin.x + uv.x * (uvMax.x - uvMin.x), uvMin.y + uv.y * (uvMax.y - uvMin.y));
+    }
+};
+
+// runtime side of tools/build_atlas.cpp: reads the .atlas remap table, loads
+// the baked atlas texture next to it and resolves image names to regions.
+//
+// table format, one record per line:
+//   atlas <texture file> <width> <height> <levels>
+//   sprite <name> <x> <y> <width> <height> <u0> <v0> <u1> <v1>
+// ------------------------------------------------------------------------
+class TextureAtlas
+{
+public:
+    GLuint texture = 0;
+    int width = 0, height = 0, levels = 0;
+
+    // parse the table; the texture is only created if loadTexture is set, so
+    // the table can also be read without a GL context
+    bool load(const std::string &tablePath, bool loadTexture = true)
+    {
+        std::ifstream file(tablePath);
+        if (!file)
+        {
+            std::cout << "ERROR::ATLAS::FILE_NOT_SUCCESFULLY_READ: " << tablePath << std::endl;
+            return false;
+        }
+        regions.clear();
+        std::string texturePath, line;
+        while (std::getline(file, line))
+        {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            if (kind == "atlas")
+            {
+                fields >> texturePath >> width >> height >> levels;
+            }
+            else if (kind == "sprite")
+            {
+                AtlasRegion region;
+                fields >> region.name >> region.x >> region.y >> region.width >> region.height
+                       >> region.uvMin.x >> region.uvMin.y >> region.uvMax.x >> region.uvMax.y;
+                if (fields)
+                    regions.push_back(region);
+            }
+        }
+        std::sort(regions.begin(), regions.end(),
+            [](const AtlasRegion &a, const AtlasRegion &b) { return a.name < b.name; });
+        if (!loadTexture)
+            return true;
+
+        // the texture file is stored relative to the table
+        size_t slash = tablePath.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "" : tablePath.substr(0, slash + 1);
+        // gutters only cover the baked levels, so don't filter across sprites with more
+        texture = loadBakedTexture((directory + texturePath).c_str(), true, GL_CLAMP_TO_EDGE, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+        if (!texture)
+        {
+            std::cout << "ERROR::ATLAS::TEXTURE_NOT_LOADED: " << directory + texturePath << std::endl;
+            return false;
+        }
+        return true;
+    }
+    // NULL if the atlas has no image with that name
+    const AtlasRegion *find(const std::string &name) const
+    {
+        auto it = std::lower_bound(regions.begin(), regions.end(), name,
+            [](const AtlasRegion &region, const std::string &n) { return region.name < n; });
+        if (it == regions.end() || it->name != name)
+            return NULL;
+        return &*it;
+    }
+    const std::vector<AtlasRegion> &allRegions() const
+    {
+        return regions;
+    }
+
+private:
+    std::vector<AtlasRegion> regions;
+};
+#endif
@@ -0,0 +1,185 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// GPU time of whole frames with GL_TIME_ELAPSED queries. Results are read
+// back a few frames late from a small ring of queries, so timing never
+// stalls the pipeline waiting for the GPU to catch up.
+// ------------------------------------------------------------------------
+class GpuFrameTimer
+{
+public:
+    static const int RING_SIZE = 4;
+
+    void init()
+    {
+        glGenQueries(RING_SIZE, queries);
+    }
+    void destroy()
+    {
+        glDeleteQueries(RING_SIZE, queries);
+    }
+    // a timer query can't nest in another of the same target: call once per frame
+    void begin()
+    {
+        // the slot is still in flight if the GPU is RING_SIZE frames behind; wait for it
+        if (inFlight == RING_SIZE)
+            collect(true);
+        glBeginQuery(GL_TIME_ELAPSED, queries[(first + inFlight) % RING_SIZE]);
+    }
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        inFlight++;
+    }
+    // move finished results into results(); wait makes it take the oldest
+    // one even if the GPU isn't done with it yet
+    void collect(bool wait = false)
+    {
+        while (inFlight > 0)
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[first], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available && !wait)
+                return;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[first], GL_QUERY_RESULT, &elapsed);
+            times.push_back(elapsed * 1e-6);
+            first = (first + 1) % RING_SIZE;
+            inFlight--;
+            wait = false;
+        }
+    }
+    // finish everything still in flight
+    void flush()
+    {
+        while (inFlight > 0)
+            collect(true);
+    }
+    // one entry per timed frame, in milliseconds, oldest first
+    std::vector<double> &results()
+    {
+        return times;
+    }
+
+private:
+    GLuint queries[RING_SIZE];
+    int first = 0, inFlight = 0;
+    std::vector<double> times;
+};
+
+// summary of a series of frame times
+struct FrameTimeSummary
+{
+    double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+
+    // nearest-rank percentiles
+    static FrameTimeSummary of(std::vector<double> samples)
+    {
+        FrameTimeSummary summary;
+        if (samples.empty())
+            return summary;
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&samples](double p) {
+            size_t rank = (size_t)(p / 100.0 * samples.size() + 0.999999);
+            return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+        };
+        double sum = 0.0;
+        for (double sample : samples)
+            sum += sample;
+        summary.mean = sum / samples.size();
+        summary.p50 = percentile(50.0);
+        summary.p95 = percentile(95.0);
+        summary.p99 = percentile(99.0);
+        summary.max = samples.back();
+        return summary;
+    }
+};
+
+// per-frame CPU and GPU times of a benchmark run, written out as JSON for
+// tools/bench_compare.cpp. The first warmup frames are dropped: they pay for
+// shader compiles, texture uploads and driver warm-up.
+// ------------------------------------------------------------------------
+class BenchmarkRecorder
+{
+public:
+    unsigned long warmupFrames = 10;
+    // free-form description of the run, written out as strings
+    std::vector<std::pair<std::string, std::string>> info;
+    // extra per-frame numbers (GL call counts, ...), written under "counters"
+    std::vector<std::pair<std::string, double>> counters;
+
+    void addCpuFrame(double milliseconds)
+    {
+        cpuTimes.push_back(milliseconds);
+    }
+    bool write(const std::string &path, const std::vector<double> &gpuTimes) const
+    {
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        fprintf(file, "{\n");
+        for (const auto &entry : info)
+            fprintf(file, "  \"%s\": \"%s\",\n", entry.first.c_str(), escape(entry.second).c_str());
+        std::vector<double> cpu = dropWarmup(cpuTimes), gpu = dropWarmup(gpuTimes);
+        fprintf(file, "  \"frames\": %zu,\n", cpu.size());
+        fprintf(file, "  \"warmup_frames\": %lu,\n", warmupFrames);
+        if (!counters.empty())
+        {
+            fprintf(file, "  \"counters\": {");
+            for (size_t i = 0; i < counters.size(); i++)
+                fprintf(file, "%s \"%s\": %.4f", i ? "," : "", counters[i].first.c_str(), counters[i].second);
+            fprintf(file, " },\n");
+        }
+        writeSummary(file, "cpu_ms", FrameTimeSummary::of(cpu), true);
+        writeSummary(file, "gpu_ms", FrameTimeSummary::of(gpu), false);
+        fprintf(file, "}\n");
+        return fclose(file) == 0;
+    }
+    // the same numbers in a line for the console
+    void print(const std::vector<double> &gpuTimes) const
+    {
+        FrameTimeSummary cpu = FrameTimeSummary::of(dropWarmup(cpuTimes));
+        FrameTimeSummary gpu = FrameTimeSummary::of(dropWarmup(gpuTimes));
+        printf("cpu ms: p50 %.3f p95 %.3f p99 %.3f max %.3f | gpu ms: p50 %.3f p95 %.3f p99 %.3f max %.3f\n",
+               cpu.p50, cpu.p95, cpu.p99, cpu.max, gpu.p50, gpu.p95, gpu.p99, gpu.max);
+    }
+
+private:
+    std::vector<double> cpuTimes;
+
+    std::vector<double> dropWarmup(const std::vector<double> &times) const
+    {
+        if (times.size() <= warmupFrames)
+            return std::vector<double>();
+        return std::vector<double>(times.begin() + warmupFrames, times.end());
+    }
+    static std::string escape(const std::string &text)
+    {
+        std::string out;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if ((unsigned char)c >= 0x20)
+                out += c;
+        }
+        return out;
+    }
+    static void writeSummary(FILE *file, const char *name, const FrameTimeSummary &summary, bool more)
+    {
+        fprintf(file, "  \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+                name, summary.mean, summary.p50, summary.p95, summary.p99, summary.max, more ? "," : "");
+    }
+};
+#endif
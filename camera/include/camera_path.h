@@ -0,0 +1,95 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+// one keyframe of a scripted camera; angles are in degrees like the mouse look
+struct CameraKey
+{
+    float time;
+    glm::vec3 position;
+    float yaw, pitch, fov;
+};
+
+// a scripted camera path for benchmarks: keyframes sorted by time, linearly
+// interpolated and clamped at both ends. Yaw is interpolated as written, so
+// write it unwrapped (350 -> 370 rather than 350 -> 10).
+//
+// file format, one keyframe per line, '#' starts a comment:
+//   <time> <x> <y> <z> <yaw> <pitch> <fov>
+// ------------------------------------------------------------------------
+class CameraPath
+{
+public:
+    bool load(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::CAMERA_PATH::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return false;
+        }
+        keys.clear();
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            lineNumber++;
+            size_t comment = line.find('#');
+            if (comment != std::string::npos)
+                line.erase(comment);
+            std::istringstream fields(line);
+            CameraKey key;
+            if (!(fields >> key.time))
+                continue;
+            if (!(fields >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch >> key.fov))
+            {
+                std::cout << "ERROR::CAMERA_PATH::BAD_KEYFRAME: " << path << ":" << lineNumber << std::endl;
+                return false;
+            }
+            keys.push_back(key);
+        }
+        if (keys.empty())
+        {
+            std::cout << "ERROR::CAMERA_PATH::NO_KEYFRAMES: " << path << std::endl;
+            return false;
+        }
+        std::stable_sort(keys.begin(), keys.end(),
+            [](const CameraKey &a, const CameraKey &b) { return a.time < b.time; });
+        return true;
+    }
+    // the camera at time t
+    CameraKey sample(float t) const
+    {
+        if (t <= keys.front().time)
+            return keys.front();
+        if (t >= keys.back().time)
+            return keys.back();
+        auto next = std::upper_bound(keys.begin(), keys.end(), t,
+            [](float time, const CameraKey &key) { return time < key.time; });
+        const CameraKey &a = *(next - 1), &b = *next;
+        float s = (t - a.time) / (b.time - a.time);
+        CameraKey key;
+        key.time = t;
+        key.position = a.position + (b.position - a.position) * s;
+        key.yaw = a.yaw + (b.yaw - a.yaw) * s;
+        key.pitch = a.pitch + (b.pitch - a.pitch) * s;
+        key.fov = a.fov + (b.fov - a.fov) * s;
+        return key;
+    }
+    float duration() const
+    {
+        return keys.empty() ? 0.0f : keys.back().time;
+    }
+
+private:
+    std::vector<CameraKey> keys;
+};
+#endif
@@ -0,0 +1,189 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// CPU zones: PROFILE_ZONE("name") times the rest of the enclosing scope on the
+// calling thread, PROFILE_FUNCTION() does the same named after the function
+// and PROFILE_THREAD("name") labels the calling thread in the trace. Names
+// must be string literals, only the pointer is stored.
+//
+// Unless CPU_PROFILE is defined (make PROFILE=1) the macros expand to nothing
+// and no code is generated at all. With it, each thread records into its own
+// ring buffer with no locks or atomics read-modify-writes on the hot path; the
+// newest EVENTS_PER_THREAD zones per thread are kept, like a flight recorder,
+// and CpuProfiler::writeChromeTrace() exports them on demand for
+// chrome://tracing or Perfetto.
+#ifdef CPU_PROFILE
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() CpuZone PROFILE_CONCAT(profileZone, __LINE__)(__func__)
+#define PROFILE_THREAD(name) CpuProfiler::setThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+class CpuProfiler
+{
+public:
+    static const size_t EVENTS_PER_THREAD = 1 << 15;
+    // whether the zone macros record anything in this build
+#ifdef CPU_PROFILE
+    static const bool COMPILED_IN = true;
+#else
+    static const bool COMPILED_IN = false;
+#endif
+
+    struct Event
+    {
+        const char *name;
+        uint64_t begin, end;    // nanoseconds since the profiler's epoch
+    };
+
+    // one per thread, written only by its thread. head counts every event ever
+    // written; the reader takes what it needs from a snapshot of it.
+    struct ThreadBuffer
+    {
+        std::vector<Event> events;
+        std::atomic<uint64_t> head{0};
+        uint32_t id;
+        std::string name;
+    };
+
+    static uint64_t now()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // ------------------------------------------------------------------------
+    static void record(const char *name, uint64_t begin, uint64_t end)
+    {
+        ThreadBuffer &buffer = threadBuffer();
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        Event &event = buffer.events[head & (EVENTS_PER_THREAD - 1)];
+        event.name = name;
+        event.begin = begin;
+        event.end = end;
+        // publish: the event is written before the reader can see the new head
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+    static void setThreadName(const char *name)
+    {
+        ThreadBuffer &buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer.name = name;
+    }
+
+    // copy the events every thread currently holds, oldest first per thread.
+    // Safe while other threads keep recording: events that may have been
+    // overwritten during the copy are thrown away.
+    // ------------------------------------------------------------------------
+    static void snapshot(std::vector<std::pair<const ThreadBuffer *, std::vector<Event>>> &out)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        out.clear();
+        for (const std::unique_ptr<ThreadBuffer> &buffer : buffers)
+        {
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t first = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+            std::vector<Event> events;
+            events.reserve((size_t)(head - first));
+            for (uint64_t i = first; i < head; i++)
+                events.push_back(buffer->events[i & (EVENTS_PER_THREAD - 1)]);
+            // the writer may have lapped the oldest entries while we copied.
+            // Event after - EVENTS_PER_THREAD shares its slot with event
+            // after, which the writer may be filling in right now, so only
+            // events from after - EVENTS_PER_THREAD + 1 on are known whole.
+            uint64_t after = buffer->head.load(std::memory_order_acquire);
+            uint64_t safeFirst = after + 1 > EVENTS_PER_THREAD ? after + 1 - EVENTS_PER_THREAD : 0;
+            if (safeFirst > first)
+            {
+                size_t stale = (size_t)std::min<uint64_t>(safeFirst - first, events.size());
+                events.erase(events.begin(), events.begin() + stale);
+            }
+            out.emplace_back(buffer.get(), std::move(events));
+        }
+    }
+
+    // Chrome trace-event JSON: one complete ("X") event per zone and a
+    // thread_name record per thread
+    // ------------------------------------------------------------------------
+    static bool writeChromeTrace(const std::string &path)
+    {
+        std::vector<std::pair<const ThreadBuffer *, std::vector<Event>>> threads;
+        snapshot(threads);
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cout << "ERROR::CPU_PROFILER::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const auto &thread : threads)
+        {
+            std::string name = thread.first->name.empty() ? "thread " + std::to_string(thread.first->id) : thread.first->name;
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", thread.first->id, name.c_str());
+            first = false;
+            for (const Event &event : thread.second)
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                        event.name, thread.first->id, event.begin * 1e-3, (event.end - event.begin) * 1e-3);
+        }
+        fprintf(file, "\n]}\n");
+        return fclose(file) == 0;
+    }
+
+private:
+    static inline const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    static inline std::mutex registryMutex;
+    // buffers outlive their threads so a late export still sees them
+    static inline std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    static ThreadBuffer &threadBuffer()
+    {
+        thread_local ThreadBuffer *buffer = NULL;
+        if (!buffer)
+        {
+            std::unique_ptr<ThreadBuffer> created(new ThreadBuffer());
+            created->events.resize(EVENTS_PER_THREAD);
+            std::lock_guard<std::mutex> lock(registryMutex);
+            created->id = (uint32_t)buffers.size() + 1;
+            buffer = created.get();
+            buffers.push_back(std::move(created));
+        }
+        return *buffer;
+    }
+};
+
+// records its lifetime as one zone
+// ------------------------------------------------------------------------
+class CpuZone
+{
+public:
+    explicit CpuZone(const char *name) : name(name), begin(CpuProfiler::now()) {}
+    ~CpuZone()
+    {
+        CpuProfiler::record(name, begin, CpuProfiler::now());
+    }
+    CpuZone(const CpuZone&) = delete;
+    CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+    const char *name;
+    uint64_t begin;
+};
+#endif
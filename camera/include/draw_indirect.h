@@ -0,0 +1,109 @@
+#ifndef DRAW_INDIRECT_H
+#define DRAW_INDIRECT_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "cpu_profiler.h"
+#include "mesh_arena.h"
+
+#include <cstdint>
+#include <vector>
+
+// one draw of a glMultiDrawElementsIndirect batch, laid out as GL reads it
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "indirect command layout");
+
+// a bucket of draws from one MeshArena with one program, built on the CPU
+// every frame and submitted with a single glMultiDrawElementsIndirect. Each
+// command's baseInstance is the index of its first object in the object
+// buffer, which the shader reads back as gl_BaseInstanceARB.
+//
+// Without multi-draw indirect, shader draw parameters or base instance draws
+// (or with --no-indirect) the commands are replayed one by one, setting the
+// baseObject uniform in place of gl_BaseInstanceARB.
+// ------------------------------------------------------------------------
+class DrawBuilder
+{
+public:
+    GLuint ID = 0;
+
+    void init()
+    {
+        glGenBuffers(1, &ID);
+    }
+    void clear()
+    {
+        commands.clear();
+    }
+    // draw instanceCount copies of a mesh, for objects firstObject onwards
+    void add(const MeshRange &mesh, GLuint firstObject, GLuint instanceCount = 1)
+    {
+        if (instanceCount == 0)
+            return;
+        DrawElementsIndirectCommand command;
+        command.count = mesh.indexCount;
+        command.instanceCount = instanceCount;
+        command.firstIndex = mesh.firstIndex;
+        command.baseVertex = mesh.baseVertex;
+        command.baseInstance = firstObject;
+        commands.push_back(command);
+    }
+    // true when submit() issues one call for the whole bucket; a non-zero
+    // baseInstance in the commands needs ARB_base_instance as well
+    static bool indirect()
+    {
+        return GLExt.multiDrawIndirect && GLExt.shaderDrawParameters && GLExt.baseInstance;
+    }
+    // draw every command; the program must be bound. baseObjectLocation is
+    // only used by the fallback, -1 if the program doesn't have it
+    // ------------------------------------------------------------------------
+    void submit(const MeshArena &arena, GLint baseObjectLocation = -1)
+    {
+        PROFILE_ZONE("DrawBuilder::submit");
+        if (commands.empty())
+            return;
+        GLState.bindVertexArray(arena.VAO);
+        if (indirect())
+        {
+            GLState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, ID);
+            // orphan, last frame's commands may still be read
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, arena.indexType, (void*)0, (GLsizei)commands.size(), 0);
+            return;
+        }
+        for (const DrawElementsIndirectCommand &command : commands)
+        {
+            const void *first = (const void*)(command.firstIndex * arena.indexSize());
+            if (baseObjectLocation != -1)
+                glUniform1i(baseObjectLocation, (GLint)command.baseInstance);
+            if (GLExt.baseInstance)
+                glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, arena.indexType, first,
+                    command.instanceCount, command.baseVertex, command.baseInstance);
+            else
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, arena.indexType, first,
+                    command.instanceCount, command.baseVertex);
+        }
+    }
+    size_t drawCount() const
+    {
+        return commands.size();
+    }
+    void destroy()
+    {
+        GLState.bufferDeleted(ID);
+        glDeleteBuffers(1, &ID);
+        ID = 0;
+    }
+
+private:
+    std::vector<DrawElementsIndirectCommand> commands;
+};
+#endif
@@ -0,0 +1,417 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "cpu_profiler.h"
+#include "image_encode.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum CaptureFormat
+{
+    CAPTURE_PNG,    // one numbered file per frame
+    CAPTURE_Y4M     // one uncompressed YUV 4:2:0 stream
+};
+
+// records every rendered frame to disk without stalling the render loop.
+// capture() only queues a glReadPixels into one of SLOTS pixel pack
+// buffers and fences it; the pixels are fetched once the fence has passed,
+// normally a frame or two later, and encoded and written by worker threads.
+//
+// With buffer storage (GL 4.4) the pack buffers stay mapped and the workers
+// read them in place. Without, the main thread maps each one when its fence
+// has passed and copies it into a pooled CPU buffer, which still never
+// waits on the GPU. Only when the workers fall SLOTS frames behind does
+// capture() wait for them; stallCount() says how often.
+// ------------------------------------------------------------------------
+class FrameCapture
+{
+public:
+    static const int SLOTS = 3;
+
+    // path ending in .y4m records a Y4M stream, anything else is a prefix for
+    // <path>_000000.png, ... fps only goes into the Y4M header. The size is
+    // fixed for the whole recording, as the pack buffers and a Y4M stream are.
+    // ------------------------------------------------------------------------
+    bool start(const std::string &path, int width, int height, int fps, unsigned int threads = 2)
+    {
+        this->width = width;
+        this->height = height;
+        frameBytes = (size_t)width * height * 4;
+        format = path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0 ? CAPTURE_Y4M : CAPTURE_PNG;
+        prefix = path;
+        if (format == CAPTURE_Y4M)
+        {
+            stream = fopen(path.c_str(), "wb");
+            if (!stream)
+            {
+                std::cout << "ERROR::FRAME_CAPTURE::FILE_NOT_OPENED: " << path << std::endl;
+                return false;
+            }
+            fprintf(stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps > 0 ? fps : 60);
+        }
+
+        persistentMap = GLExt.bufferStorage;
+        for (Slot &slot : slots)
+        {
+            glGenBuffers(1, &slot.pbo);
+            GLState.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            if (persistentMap)
+            {
+                glBufferStorage(GL_PIXEL_PACK_BUFFER, frameBytes, NULL,
+                                GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT | GL_CLIENT_STORAGE_BIT);
+                slot.mapped = (const uint8_t *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes,
+                                                                GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+                if (!slot.mapped)
+                {
+                    std::cout << "ERROR::FRAME_CAPTURE::MAP_FAILED" << std::endl;
+                    release();
+                    return false;
+                }
+            }
+            else
+            {
+                glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+            }
+        }
+        // a pack buffer left bound would redirect every later glReadPixels
+        GLState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (threads == 0)
+            threads = 1;
+        stopping = false;
+        for (unsigned int i = 0; i < threads; i++)
+            workers.emplace_back(&FrameCapture::workerLoop, this);
+        // enough for every slot plus one frame per worker to be in flight
+        if (!persistentMap)
+            for (unsigned int i = 0; i < SLOTS + threads; i++)
+                freeBuffers.push_back(new std::vector<uint8_t>(frameBytes));
+        running = true;
+        return true;
+    }
+    bool active() const
+    {
+        return running;
+    }
+
+    // queue a copy of framebuffer's current contents; call after the last
+    // draw of the frame, before presenting it. width and height are the
+    // framebuffer's current size: if it no longer matches the size capture
+    // started with, the recording ends here with what it has so far rather
+    // than reading past a smaller framebuffer or cropping a bigger one.
+    // ------------------------------------------------------------------------
+    void capture(GLuint framebuffer, int framebufferWidth, int framebufferHeight)
+    {
+        if (!running)
+            return;
+        PROFILE_ZONE("FrameCapture::capture");
+        if (framebufferWidth != width || framebufferHeight != height)
+        {
+            std::cout << "ERROR::FRAME_CAPTURE::SIZE_CHANGED: " << framebufferWidth << "x" << framebufferHeight
+                      << " framebuffer, recording is " << width << "x" << height << "; stopped after "
+                      << framesQueued << " frames" << std::endl;
+            finish();
+            return;
+        }
+        // hand over whatever the GPU has finished since last frame
+        while (retrieve(false))
+            ;
+        Slot &slot = slots[next];
+        if (slot.state.load(std::memory_order_acquire) == SLOT_PENDING)
+        {
+            stalls++;
+            retrieve(true);
+        }
+        if (slot.state.load(std::memory_order_acquire) == SLOT_ENCODING)
+        {
+            stalls++;
+            std::unique_lock<std::mutex> lock(mutex);
+            released.wait(lock, [&slot]() { return slot.state.load(std::memory_order_acquire) == SLOT_FREE; });
+        }
+
+        GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        GLState.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        GLState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = framesQueued++;
+        slot.state.store(SLOT_PENDING, std::memory_order_release);
+        next = (next + 1) % SLOTS;
+    }
+
+    // fetch and encode everything still queued, then stop the workers and
+    // release the GL objects; needs the context, so call it before tearing down
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        if (!running)
+            return;
+        PROFILE_ZONE("FrameCapture::finish");
+        while (retrieve(true))
+            ;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            released.wait(lock, [this]() { return jobs.empty() && busyWorkers == 0; });
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+        workers.clear();
+        release();
+        running = false;
+    }
+    ~FrameCapture()
+    {
+        // finish() wasn't called: the GL objects go with the context, but the
+        // threads must not outlive this
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+        for (Job &job : jobs)
+            delete job.buffer;
+        for (std::vector<uint8_t> *buffer : freeBuffers)
+            delete buffer;
+        if (stream)
+            fclose(stream);
+    }
+
+    unsigned long framesWritten() const
+    {
+        return written.load();
+    }
+    // frames whose capture() had to wait
+    unsigned long stallCount() const
+    {
+        return stalls;
+    }
+    const char *formatName() const
+    {
+        return format == CAPTURE_Y4M ? "y4m" : "png";
+    }
+
+private:
+    enum SlotState
+    {
+        SLOT_FREE,
+        SLOT_PENDING,   // read queued, fence not yet seen
+        SLOT_ENCODING   // a worker is reading the mapping
+    };
+    struct Slot
+    {
+        GLuint pbo = 0;
+        GLsync fence = 0;
+        const uint8_t *mapped = nullptr;
+        unsigned long frame = 0;
+        std::atomic<int> state{ SLOT_FREE };
+    };
+    // pixels are either a slot's mapping or a pooled buffer
+    struct Job
+    {
+        unsigned long frame;
+        const uint8_t *pixels;
+        Slot *slot;
+        std::vector<uint8_t> *buffer;
+    };
+
+    CaptureFormat format = CAPTURE_PNG;
+    std::string prefix;
+    FILE *stream = NULL;
+    int width = 0, height = 0;
+    size_t frameBytes = 0;
+    bool persistentMap = false;
+    bool running = false;
+    Slot slots[SLOTS];
+    int next = 0;
+    unsigned long framesQueued = 0;
+    unsigned long stalls = 0;
+    std::atomic<unsigned long> written{ 0 };
+
+    // guards everything below, shared with the workers
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    // a slot or buffer came back, or a job finished
+    std::condition_variable released;
+    std::deque<Job> jobs;
+    std::vector<std::vector<uint8_t>*> freeBuffers;
+    std::vector<std::thread> workers;
+    unsigned int busyWorkers = 0;
+    bool stopping = false;
+    // Y4M frames are appended strictly in order
+    unsigned long nextToWrite = 0;
+    bool reportedWriteError = false;
+
+    // everything but the threads
+    void release()
+    {
+        for (Slot &slot : slots)
+        {
+            if (!slot.pbo)
+                continue;
+            GLState.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            if (slot.mapped)
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            GLState.bufferDeleted(slot.pbo);
+            glDeleteBuffers(1, &slot.pbo);
+            slot.pbo = 0;
+            slot.mapped = nullptr;
+        }
+        next = 0;
+        for (std::vector<uint8_t> *buffer : freeBuffers)
+            delete buffer;
+        freeBuffers.clear();
+        if (stream)
+            fclose(stream);
+        stream = NULL;
+    }
+    // hands the oldest pending slot, in capture order, to the workers; false
+    // if there is none or its fence hasn't passed and wait is false
+    bool retrieve(bool wait)
+    {
+        Slot *oldest = nullptr;
+        for (int i = 0; i < SLOTS; i++)
+        {
+            Slot &slot = slots[(next + i) % SLOTS];
+            if (slot.state.load(std::memory_order_acquire) == SLOT_PENDING)
+            {
+                oldest = &slot;
+                break;
+            }
+        }
+        if (!oldest)
+            return false;
+        GLenum status = glClientWaitSync(oldest->fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ull : 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(oldest->fence, 0, 1000000000ull);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(oldest->fence);
+        oldest->fence = 0;
+
+        Job job;
+        job.frame = oldest->frame;
+        if (persistentMap)
+        {
+            // the workers read the mapping; the slot comes back when they are done
+            job.pixels = oldest->mapped;
+            job.slot = oldest;
+            job.buffer = nullptr;
+            oldest->state.store(SLOT_ENCODING, std::memory_order_release);
+        }
+        else
+        {
+            std::vector<uint8_t> *buffer;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (freeBuffers.empty())
+                    stalls++;
+                released.wait(lock, [this]() { return !freeBuffers.empty(); });
+                buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+            }
+            PROFILE_ZONE("FrameCapture::map");
+            GLState.bindBuffer(GL_PIXEL_PACK_BUFFER, oldest->pbo);
+            const void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+            if (data)
+                memcpy(buffer->data(), data, frameBytes);
+            else
+                std::cout << "ERROR::FRAME_CAPTURE::MAP_FAILED" << std::endl;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            GLState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            job.pixels = buffer->data();
+            job.slot = nullptr;
+            job.buffer = buffer;
+            oldest->state.store(SLOT_FREE, std::memory_order_release);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        jobReady.notify_one();
+        return true;
+    }
+
+    void workerLoop()
+    {
+        PROFILE_THREAD("frame capture");
+        std::vector<uint8_t> yuv;
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = jobs.front();
+                jobs.pop_front();
+                busyWorkers++;
+            }
+            bool ok = format == CAPTURE_Y4M ? writeY4mFrame(job, yuv) : writePngFrame(job);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok && !reportedWriteError)
+                {
+                    std::cout << "ERROR::FRAME_CAPTURE::WRITE_FAILED: frame " << job.frame << std::endl;
+                    reportedWriteError = true;
+                }
+                if (job.slot)
+                    job.slot->state.store(SLOT_FREE, std::memory_order_release);
+                if (job.buffer)
+                    freeBuffers.push_back(job.buffer);
+                busyWorkers--;
+            }
+            written++;
+            released.notify_all();
+        }
+    }
+    bool writePngFrame(const Job &job)
+    {
+        PROFILE_ZONE("encode png");
+        char number[16];
+        snprintf(number, sizeof(number), "_%06lu.png", job.frame);
+        FILE *file = fopen((prefix + number).c_str(), "wb");
+        if (!file)
+            return false;
+        bool ok = ImageEncode::writePng(file, job.pixels, width, height);
+        return fclose(file) == 0 && ok;
+    }
+    bool writeY4mFrame(const Job &job, std::vector<uint8_t> &yuv)
+    {
+        size_t lumaBytes = (size_t)width * height;
+        size_t chromaBytes = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+        yuv.resize(lumaBytes + 2 * chromaBytes);
+        {
+            PROFILE_ZONE("rgb to yuv");
+            ImageEncode::rgbaToYuv420(job.pixels, width, height, yuv.data(), yuv.data() + lumaBytes,
+                                      yuv.data() + lumaBytes + chromaBytes);
+        }
+        // converted in parallel, appended in order
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [this, &job]() { return nextToWrite == job.frame; });
+        bool ok = fwrite("FRAME\n", 1, 6, stream) == 6 && fwrite(yuv.data(), 1, yuv.size(), stream) == yuv.size();
+        nextToWrite++;
+        lock.unlock();
+        released.notify_all();
+        return ok;
+    }
+};
+#endif
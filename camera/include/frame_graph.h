@@ -0,0 +1,633 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+// a resource declared to a FrameGraph, valid until the next reset()
+typedef uint32_t FrameResource;
+
+// a transient render target: a sized internal format, and either a fraction
+// of the graph's extent (so it follows the window) or a fixed width and height
+struct RenderTargetDesc
+{
+    GLenum format = GL_RGBA8;
+    float scale = 1.0f;
+    int width = 0, height = 0;
+};
+
+// the frame as passes that declare what they read and write. Every frame
+// the passes are declared again, compile() works out the rest and execute()
+// runs them:
+//   - ordering: writers of a resource run in declaration order, and a pass
+//     that only reads it runs after all of them
+//   - culling: a pass runs only if it writes something imported (the window,
+//     a texture or buffer owned elsewhere), is marked keep(), or writes
+//     something a running pass reads
+//   - aliasing: transient targets whose lifetimes don't overlap share one
+//     pooled texture. Contents are not kept between uses, so the first pass
+//     writing a transient target must clear or cover all of it.
+// Pooled textures and the framebuffers built from them outlive the
+// declarations, so a graph that looks the same every frame creates nothing.
+// setExtent() only records the new size; a pooled texture is re-specified
+// the next time a pass uses it, under the same name, so its framebuffers
+// stay valid. Textures no pass has used for IDLE_FRAMES are released.
+//
+// Passes that write transient targets get them bound as a framebuffer
+// (colour attachments in write order, the depth target as depth) and the
+// viewport set to their size; passes writing an imported framebuffer get
+// that. Anything else about GL state is up to the pass.
+// ------------------------------------------------------------------------
+class FrameGraph
+{
+public:
+    static const unsigned long IDLE_FRAMES = 3;
+    static const int MAX_COLOR_ATTACHMENTS = 4;
+    typedef std::function<void()> PassBody;
+
+    // declares the resources of the pass it was returned for
+    class PassBuilder
+    {
+    public:
+        PassBuilder(FrameGraph &graph, uint32_t pass) : graph(graph), pass(pass) {}
+        PassBuilder &read(FrameResource resource)
+        {
+            addUnique(graph.passes[pass].reads, resource);
+            return *this;
+        }
+        PassBuilder &write(FrameResource resource)
+        {
+            addUnique(graph.passes[pass].writes, resource);
+            return *this;
+        }
+        // never cull the pass, it has effects the graph doesn't see
+        PassBuilder &keep()
+        {
+            graph.passes[pass].keep = true;
+            return *this;
+        }
+
+    private:
+        FrameGraph &graph;
+        uint32_t pass;
+
+        static void addUnique(std::vector<FrameResource> &list, FrameResource resource)
+        {
+            for (FrameResource existing : list)
+                if (existing == resource)
+                    return;
+            list.push_back(resource);
+        }
+    };
+
+    // times every pass that runs under its name when set
+    GpuProfiler *profiler = NULL;
+
+    void destroy()
+    {
+        for (CachedFramebuffer &cached : framebuffers)
+        {
+            GLState.framebufferDeleted(cached.id);
+            glDeleteFramebuffers(1, &cached.id);
+        }
+        framebuffers.clear();
+        for (Target &target : targets)
+            releaseTexture(target);
+        targets.clear();
+    }
+    // size of the window the relative targets follow; takes effect lazily
+    void setExtent(int w, int h)
+    {
+        extentWidth = w > 0 ? w : 1;
+        extentHeight = h > 0 ? h : 1;
+    }
+    // forget the last frame's passes and resources (not the pooled targets)
+    void reset()
+    {
+        passes.clear();
+        resources.clear();
+        schedule.clear();
+        culled = 0;
+    }
+
+    // declaring resources
+    // ------------------------------------------------------------------------
+    FrameResource importFramebuffer(const char *name, GLuint framebuffer)
+    {
+        return addResource(name, RESOURCE_FRAMEBUFFER, framebuffer);
+    }
+    FrameResource importTexture(const char *name, GLuint texture)
+    {
+        return addResource(name, RESOURCE_TEXTURE, texture);
+    }
+    FrameResource importBuffer(const char *name, GLuint buffer)
+    {
+        return addResource(name, RESOURCE_BUFFER, buffer);
+    }
+    FrameResource createTexture(const char *name, const RenderTargetDesc &desc)
+    {
+        FrameResource resource = addResource(name, RESOURCE_TEXTURE, 0);
+        resources[resource].transient = true;
+        resources[resource].desc = desc;
+        return resource;
+    }
+    PassBuilder addPass(const char *name, PassBody body)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.body = body;
+        passes.push_back(pass);
+        return PassBuilder(*this, (uint32_t)(passes.size() - 1));
+    }
+
+    // order, cull and assign pooled targets; false if the passes depend on
+    // each other in a cycle, in which case they run in declaration order
+    // ------------------------------------------------------------------------
+    bool compile()
+    {
+        PROFILE_ZONE("FrameGraph::compile");
+        for (Resource &resource : resources)
+            resource.writers.clear();
+        for (uint32_t p = 0; p < passes.size(); p++)
+            for (FrameResource resource : passes[p].writes)
+                resources[resource].writers.push_back(p);
+
+        // edges from each writer to the passes that must come after it
+        std::vector<std::vector<uint32_t>> successors(passes.size());
+        std::vector<uint32_t> pending(passes.size(), 0);
+        for (uint32_t p = 0; p < passes.size(); p++)
+        {
+            for (const Resource &resource : resources)
+            {
+                bool reads = contains(passes[p].reads, resource.index);
+                bool writes = contains(passes[p].writes, resource.index);
+                if (!reads && !writes)
+                    continue;
+                for (uint32_t writer : resource.writers)
+                {
+                    // a pure reader sees the final version, a writer follows earlier writers
+                    if (writer == p || (writes && writer > p))
+                        continue;
+                    successors[writer].push_back(p);
+                    pending[p]++;
+                }
+            }
+        }
+        std::vector<uint32_t> order;
+        std::vector<bool> placed(passes.size(), false);
+        while (order.size() < passes.size())
+        {
+            // the earliest declared pass that is ready keeps the order stable
+            uint32_t next = (uint32_t)passes.size();
+            for (uint32_t p = 0; p < passes.size() && next == passes.size(); p++)
+                if (!placed[p] && pending[p] == 0)
+                    next = p;
+            if (next == passes.size())
+                break;
+            placed[next] = true;
+            order.push_back(next);
+            for (uint32_t successor : successors[next])
+                pending[successor]--;
+        }
+        bool acyclic = order.size() == passes.size();
+        if (!acyclic)
+        {
+            std::cout << "ERROR::FRAME_GRAPH::DEPENDENCY_CYCLE" << std::endl;
+            order.clear();
+            for (uint32_t p = 0; p < passes.size(); p++)
+                order.push_back(p);
+        }
+
+        // walk back from the outputs, keeping passes whose results get used
+        for (Resource &resource : resources)
+            resource.needed = !resource.transient;
+        for (size_t i = order.size(); i-- > 0;)
+        {
+            Pass &pass = passes[order[i]];
+            pass.live = pass.keep;
+            for (FrameResource resource : pass.writes)
+                pass.live = pass.live || resources[resource].needed;
+            if (!pass.live)
+            {
+                culled++;
+                continue;
+            }
+            for (FrameResource resource : pass.reads)
+                resources[resource].needed = true;
+        }
+        for (uint32_t p : order)
+            if (passes[p].live)
+                schedule.push_back(p);
+
+        // lifetimes in schedule positions, then first fit into the pool
+        for (Resource &resource : resources)
+        {
+            resource.first = -1;
+            resource.last = -1;
+            resource.target = -1;
+        }
+        for (int i = 0; i < (int)schedule.size(); i++)
+        {
+            touch(passes[schedule[i]].reads, i);
+            touch(passes[schedule[i]].writes, i);
+        }
+        for (Target &target : targets)
+            target.busyUntil = -1;
+        for (int i = 0; i < (int)schedule.size(); i++)
+        {
+            assign(passes[schedule[i]].writes, i);
+            assign(passes[schedule[i]].reads, i);
+        }
+        return acyclic;
+    }
+
+    // run the scheduled passes
+    // ------------------------------------------------------------------------
+    void execute()
+    {
+        PROFILE_ZONE("FrameGraph::execute");
+        frame++;
+        for (uint32_t p : schedule)
+        {
+            Pass &pass = passes[p];
+            allocate(pass.reads);
+            allocate(pass.writes);
+            bindTarget(pass);
+            if (profiler)
+                profiler->beginPass(pass.name);
+            pass.body();
+            if (profiler)
+                profiler->endPass();
+        }
+        releaseIdle();
+    }
+
+    // the GL object behind a resource; for transient targets only valid
+    // while the passes run
+    GLuint texture(FrameResource resource) const
+    {
+        const Resource &r = resources[resource];
+        return r.transient ? (r.target >= 0 ? targets[r.target].texture : 0) : r.id;
+    }
+    GLuint buffer(FrameResource resource) const
+    {
+        return resources[resource].id;
+    }
+    // the framebuffer bound for the running pass
+    GLuint framebuffer() const
+    {
+        return currentFramebuffer;
+    }
+    // size a resource has at the current extent
+    int width(FrameResource resource) const
+    {
+        const Resource &r = resources[resource];
+        return r.transient ? resolve(r.desc.width, r.desc.scale, extentWidth) : extentWidth;
+    }
+    int height(FrameResource resource) const
+    {
+        const Resource &r = resources[resource];
+        return r.transient ? resolve(r.desc.height, r.desc.scale, extentHeight) : extentHeight;
+    }
+
+    // statistics for the last frame
+    // ------------------------------------------------------------------------
+    size_t passCount() const
+    {
+        return schedule.size();
+    }
+    size_t culledCount() const
+    {
+        return culled;
+    }
+    size_t targetCount() const
+    {
+        return targets.size();
+    }
+    // bytes of pooled textures
+    size_t targetBytes() const
+    {
+        size_t bytes = 0;
+        for (const Target &target : targets)
+            bytes += (size_t)target.width * target.height * bytesPerTexel(target.desc.format);
+        return bytes;
+    }
+    // bytes the transient targets that were used would take without aliasing
+    size_t transientBytes() const
+    {
+        size_t bytes = 0;
+        for (const Resource &resource : resources)
+            if (resource.transient && resource.target >= 0)
+                bytes += (size_t)width(resource.index) * height(resource.index) * bytesPerTexel(resource.desc.format);
+        return bytes;
+    }
+
+private:
+    enum ResourceKind
+    {
+        RESOURCE_TEXTURE,
+        RESOURCE_FRAMEBUFFER,
+        RESOURCE_BUFFER
+    };
+    struct Resource
+    {
+        const char *name;
+        FrameResource index;
+        ResourceKind kind;
+        GLuint id;
+        bool transient = false;
+        RenderTargetDesc desc;
+        std::vector<uint32_t> writers;
+        bool needed = false;
+        int first = -1, last = -1;  // schedule positions
+        int target = -1;            // pool index
+    };
+    struct Pass
+    {
+        const char *name;
+        PassBody body;
+        std::vector<FrameResource> reads, writes;
+        bool keep = false;
+        bool live = false;
+    };
+    // a pooled texture; width and height are what it was last specified at
+    struct Target
+    {
+        RenderTargetDesc desc;
+        GLuint texture = 0;
+        int width = 0, height = 0;
+        int busyUntil = -1;
+        unsigned long lastUsed = 0;
+    };
+    struct CachedFramebuffer
+    {
+        GLuint colors[MAX_COLOR_ATTACHMENTS];
+        GLuint depth;
+        GLuint id;
+    };
+
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    std::vector<uint32_t> schedule;
+    std::vector<Target> targets;
+    std::vector<CachedFramebuffer> framebuffers;
+    size_t culled = 0;
+    int extentWidth = 1, extentHeight = 1;
+    unsigned long frame = 0;
+    GLuint currentFramebuffer = 0;
+
+    FrameResource addResource(const char *name, ResourceKind kind, GLuint id)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.index = (FrameResource)resources.size();
+        resource.kind = kind;
+        resource.id = id;
+        resources.push_back(resource);
+        return resource.index;
+    }
+    static bool contains(const std::vector<FrameResource> &list, FrameResource resource)
+    {
+        for (FrameResource existing : list)
+            if (existing == resource)
+                return true;
+        return false;
+    }
+    static int resolve(int fixed, float scale, int extent)
+    {
+        if (fixed > 0)
+            return fixed;
+        int size = (int)(extent * scale);
+        return size > 0 ? size : 1;
+    }
+    static bool sameDesc(const RenderTargetDesc &a, const RenderTargetDesc &b)
+    {
+        return a.format == b.format && a.scale == b.scale && a.width == b.width && a.height == b.height;
+    }
+
+    // formats
+    // ------------------------------------------------------------------------
+    static bool isDepth(GLenum format)
+    {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F ||
+               format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+    static bool hasStencil(GLenum format)
+    {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+    static size_t bytesPerTexel(GLenum format)
+    {
+        switch (format)
+        {
+        case GL_R8:                 return 1;
+        case GL_RG8:
+        case GL_R16F:
+        case GL_DEPTH_COMPONENT16:  return 2;
+        case GL_RGBA16F:
+        case GL_DEPTH32F_STENCIL8:  return 8;
+        case GL_RGBA32F:            return 16;
+        default:                    return 4;
+        }
+    }
+    // any matching client format will do, nothing is uploaded
+    static void clientFormat(GLenum format, GLenum &external, GLenum &type)
+    {
+        external = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+        if (hasStencil(format))
+        {
+            external = GL_DEPTH_STENCIL;
+            type = format == GL_DEPTH24_STENCIL8 ? GL_UNSIGNED_INT_24_8 : GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+        }
+        else if (isDepth(format))
+        {
+            external = GL_DEPTH_COMPONENT;
+            type = format == GL_DEPTH_COMPONENT32F ? GL_FLOAT : GL_UNSIGNED_INT;
+        }
+        else if (format == GL_R8 || format == GL_R16F)
+            external = GL_RED;
+        else if (format == GL_RG8)
+            external = GL_RG;
+    }
+
+    // compile helpers
+    // ------------------------------------------------------------------------
+    void touch(const std::vector<FrameResource> &list, int position)
+    {
+        for (FrameResource resource : list)
+        {
+            Resource &r = resources[resource];
+            if (r.first < 0)
+                r.first = position;
+            r.last = position;
+        }
+    }
+    void assign(const std::vector<FrameResource> &list, int position)
+    {
+        for (FrameResource resource : list)
+        {
+            Resource &r = resources[resource];
+            if (!r.transient || r.first != position || r.target >= 0)
+                continue;
+            for (size_t t = 0; t < targets.size() && r.target < 0; t++)
+                if (targets[t].busyUntil < r.first && sameDesc(targets[t].desc, r.desc))
+                    r.target = (int)t;
+            if (r.target < 0)
+            {
+                targets.push_back(Target());
+                targets.back().desc = r.desc;
+                r.target = (int)targets.size() - 1;
+            }
+            targets[r.target].busyUntil = r.last;
+        }
+    }
+
+    // execute helpers
+    // ------------------------------------------------------------------------
+    // create or re-specify the pooled textures behind the transient resources
+    void allocate(const std::vector<FrameResource> &list)
+    {
+        for (FrameResource resource : list)
+        {
+            const Resource &r = resources[resource];
+            if (!r.transient)
+                continue;
+            Target &target = targets[r.target];
+            target.lastUsed = frame;
+            int w = width(resource), h = height(resource);
+            if (target.texture && target.width == w && target.height == h)
+                continue;
+            if (!target.texture)
+            {
+                glGenTextures(1, &target.texture);
+                GLState.bindTexture(GL_TEXTURE_2D, target.texture);
+                GLint filter = isDepth(target.desc.format) ? GL_NEAREST : GL_LINEAR;
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            }
+            else
+                GLState.bindTexture(GL_TEXTURE_2D, target.texture);
+            GLenum external, type;
+            clientFormat(target.desc.format, external, type);
+            glTexImage2D(GL_TEXTURE_2D, 0, target.desc.format, w, h, 0, external, type, NULL);
+            target.width = w;
+            target.height = h;
+        }
+    }
+    void bindTarget(const Pass &pass)
+    {
+        GLuint colors[MAX_COLOR_ATTACHMENTS] = {};
+        GLuint depth = 0;
+        int colorCount = 0, w = 0, h = 0;
+        for (FrameResource resource : pass.writes)
+        {
+            const Resource &r = resources[resource];
+            if (r.kind == RESOURCE_FRAMEBUFFER)
+            {
+                currentFramebuffer = r.id;
+                GLState.bindFramebuffer(GL_FRAMEBUFFER, r.id);
+                GLState.viewport(0, 0, extentWidth, extentHeight);
+                return;
+            }
+            if (!r.transient)
+                continue;
+            if (isDepth(r.desc.format))
+                depth = targets[r.target].texture;
+            else if (colorCount < MAX_COLOR_ATTACHMENTS)
+                colors[colorCount++] = targets[r.target].texture;
+            else
+                std::cout << "ERROR::FRAME_GRAPH::TOO_MANY_COLOR_ATTACHMENTS: " << pass.name << std::endl;
+            w = targets[r.target].width;
+            h = targets[r.target].height;
+        }
+        // nothing to render into, the pass keeps whatever is bound
+        if (colorCount == 0 && depth == 0)
+            return;
+        currentFramebuffer = findFramebuffer(colors, colorCount, depth);
+        GLState.bindFramebuffer(GL_FRAMEBUFFER, currentFramebuffer);
+        GLState.viewport(0, 0, w, h);
+    }
+    GLuint findFramebuffer(const GLuint *colors, int colorCount, GLuint depth)
+    {
+        for (const CachedFramebuffer &cached : framebuffers)
+        {
+            bool same = cached.depth == depth;
+            for (int i = 0; i < MAX_COLOR_ATTACHMENTS && same; i++)
+                same = cached.colors[i] == colors[i];
+            if (same)
+                return cached.id;
+        }
+        CachedFramebuffer cached;
+        for (int i = 0; i < MAX_COLOR_ATTACHMENTS; i++)
+            cached.colors[i] = colors[i];
+        cached.depth = depth;
+        glGenFramebuffers(1, &cached.id);
+        GLState.bindFramebuffer(GL_FRAMEBUFFER, cached.id);
+        GLenum drawBuffers[MAX_COLOR_ATTACHMENTS];
+        for (int i = 0; i < colorCount; i++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colors[i], 0);
+            drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+        }
+        if (depth)
+        {
+            bool stencil = false;
+            for (const Target &target : targets)
+                if (target.texture == depth)
+                    stencil = hasStencil(target.desc.format);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                                   GL_TEXTURE_2D, depth, 0);
+        }
+        if (colorCount == 0)
+            glDrawBuffer(GL_NONE);
+        else
+            glDrawBuffers(colorCount, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAME_GRAPH::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        framebuffers.push_back(cached);
+        return cached.id;
+    }
+    // free pooled textures nothing has used for a while, with their framebuffers
+    void releaseIdle()
+    {
+        for (size_t t = targets.size(); t-- > 0;)
+        {
+            if (frame - targets[t].lastUsed <= IDLE_FRAMES)
+                continue;
+            releaseTexture(targets[t]);
+            targets.erase(targets.begin() + t);
+        }
+    }
+    void releaseTexture(Target &target)
+    {
+        if (!target.texture)
+            return;
+        for (size_t i = framebuffers.size(); i-- > 0;)
+        {
+            bool uses = framebuffers[i].depth == target.texture;
+            for (int c = 0; c < MAX_COLOR_ATTACHMENTS; c++)
+                uses = uses || framebuffers[i].colors[c] == target.texture;
+            if (!uses)
+                continue;
+            GLState.framebufferDeleted(framebuffers[i].id);
+            glDeleteFramebuffers(1, &framebuffers[i].id);
+            framebuffers.erase(framebuffers.begin() + i);
+        }
+        GLState.textureDeleted(target.texture);
+        glDeleteTextures(1, &target.texture);
+        target.texture = 0;
+    }
+};
+#endif
@@ -0,0 +1,303 @@
+#ifndef FRUSTUM_CULL_H
+#define FRUSTUM_CULL_H
+
+#include <glm/glm.hpp>
+#include "cpu_profiler.h"
+#include "job_system.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRUSTUM_CULL_X86 1
+#endif
+
+// the six planes of a view frustum, normals pointing inwards and normalized
+// so a plane's dot product with a point is its distance
+// ------------------------------------------------------------------------
+struct Frustum
+{
+    glm::vec4 planes[6];    // left, right, bottom, top, near, far
+
+    // Gribb/Hartmann: each plane is the last row of the clip matrix plus or
+    // minus one of the others
+    static Frustum fromMatrix(const glm::mat4 &viewProjection)
+    {
+        const glm::mat4 &m = viewProjection;
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        Frustum frustum;
+        frustum.planes[0] = row[3] + row[0];
+        frustum.planes[1] = row[3] - row[0];
+        frustum.planes[2] = row[3] + row[1];
+        frustum.planes[3] = row[3] - row[1];
+        frustum.planes[4] = row[3] + row[2];
+        frustum.planes[5] = row[3] - row[2];
+        for (glm::vec4 &plane : frustum.planes)
+            plane = plane / glm::length(glm::vec3(plane.x, plane.y, plane.z));
+        return frustum;
+    }
+};
+
+// bounding spheres as structure of arrays, so the kernels below load the x,
+// y, z and radius of 4 or 8 spheres with one instruction each. The arrays
+// are padded to a multiple of PAD with spheres of radius -inf, which every
+// plane rejects, so the kernels never need a scalar tail.
+// ------------------------------------------------------------------------
+class BoundingSpheres
+{
+public:
+    static const size_t PAD = 8;
+    std::vector<float> x, y, z, radius;
+
+    void resize(size_t count)
+    {
+        size_t padded = (count + PAD - 1) / PAD * PAD;
+        x.resize(padded, 0.0f);
+        y.resize(padded, 0.0f);
+        z.resize(padded, 0.0f);
+        radius.resize(padded, -std::numeric_limits<float>::infinity());
+        for (size_t i = count; i < padded; i++)
+            radius[i] = -std::numeric_limits<float>::infinity();
+        numSpheres = count;
+    }
+    void set(size_t i, const glm::vec3 &center, float r)
+    {
+        x[i] = center.x;
+        y[i] = center.y;
+        z[i] = center.z;
+        radius[i] = r;
+    }
+    size_t size() const
+    {
+        return numSpheres;
+    }
+    size_t paddedSize() const
+    {
+        return x.size();
+    }
+
+private:
+    size_t numSpheres = 0;
+};
+
+enum CullKernel
+{
+    CULL_SCALAR,
+    CULL_SSE,
+    CULL_AVX2
+};
+
+// tests every sphere against a frustum and writes the indices of the ones
+// that are at least partly inside, in order, to a compacted list. A sphere
+// is kept unless it is entirely behind some plane; near the frustum's
+// corners that keeps a few that are actually outside, which is fine for
+// culling.
+//
+// The kernels work on a range of spheres starting at a multiple of PAD, and
+// never write past the range's own slots in visible, which is what lets
+// cullParallel() give each job a slice of the same array.
+// ------------------------------------------------------------------------
+class FrustumCuller
+{
+public:
+    // the widest kernel this CPU runs
+    static CullKernel best()
+    {
+#ifdef FRUSTUM_CULL_X86
+        static const CullKernel kernel = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? CULL_AVX2 : CULL_SSE;
+        return kernel;
+#else
+        return CULL_SCALAR;
+#endif
+    }
+    static const char *name(CullKernel kernel)
+    {
+        static const char *names[] = { "scalar", "sse", "avx2" };
+        return names[kernel];
+    }
+
+    // visible is grown to paddedSize() entries, as the vector kernels store
+    // whole registers; only the first count (the return value) mean anything
+    static size_t cull(const Frustum &frustum, const BoundingSpheres &spheres, std::vector<uint32_t> &visible,
+                       CullKernel kernel = best())
+    {
+        PROFILE_ZONE("FrustumCuller::cull");
+        if (visible.size() < spheres.paddedSize())
+            visible.resize(spheres.paddedSize());
+        return cullRange(frustum, spheres, 0, spheres.paddedSize(), visible.data(), kernel);
+    }
+    // the same spread over every worker: each job compacts its slice in
+    // place, then the slices are moved together. Same result as cull().
+    // ------------------------------------------------------------------------
+    static size_t cullParallel(JobSystem &jobs, const Frustum &frustum, const BoundingSpheres &spheres,
+                               std::vector<uint32_t> &visible, CullKernel kernel = best())
+    {
+        PROFILE_ZONE("FrustumCuller::cullParallel");
+        if (visible.size() < spheres.paddedSize())
+            visible.resize(spheres.paddedSize());
+        size_t grain = (jobs.grainFor(spheres.paddedSize(), 4096) + BoundingSpheres::PAD - 1)
+                       / BoundingSpheres::PAD * BoundingSpheres::PAD;
+        std::vector<size_t> counts((spheres.paddedSize() + grain - 1) / grain);
+        uint32_t *out = visible.data();
+        jobs.parallelFor(0, spheres.paddedSize(), grain, [&](size_t begin, size_t end) {
+            counts[begin / grain] = cullRange(frustum, spheres, begin, end, out + begin, kernel);
+        });
+        size_t count = 0;
+        for (size_t chunk = 0; chunk < counts.size(); chunk++)
+        {
+            if (count != chunk * grain)
+                memmove(out + count, out + chunk * grain, counts[chunk] * sizeof(uint32_t));
+            count += counts[chunk];
+        }
+        return count;
+    }
+    // spheres [first, last), first a multiple of PAD and last one too or the
+    // padded size; the indices written are absolute
+    static size_t cullRange(const Frustum &frustum, const BoundingSpheres &spheres, size_t first, size_t last,
+                            uint32_t *visible, CullKernel kernel = best())
+    {
+#ifdef FRUSTUM_CULL_X86
+        if (kernel == CULL_AVX2)
+            return cullAVX2(frustum, spheres, first, last, visible);
+        if (kernel == CULL_SSE)
+            return cullSSE(frustum, spheres, first, last, visible);
+#endif
+        return cullScalar(frustum, spheres, first, last, visible);
+    }
+
+    // ------------------------------------------------------------------------
+    static size_t cullScalar(const Frustum &frustum, const BoundingSpheres &spheres, size_t first, size_t last,
+                             uint32_t *visible)
+    {
+        size_t count = 0;
+        if (last > spheres.size())
+            last = spheres.size();
+        for (size_t i = first; i < last; i++)
+        {
+            bool inside = true;
+            for (const glm::vec4 &p : frustum.planes)
+                inside &= p.x * spheres.x[i] + p.y * spheres.y[i] + p.z * spheres.z[i] + p.w + spheres.radius[i] >= 0.0f;
+            visible[count] = (uint32_t)i;
+            count += inside;
+        }
+        return count;
+    }
+
+#ifdef FRUSTUM_CULL_X86
+    // 4 spheres per iteration; SSE2 is part of x86-64, no dispatch needed
+    // ------------------------------------------------------------------------
+    static size_t cullSSE(const Frustum &frustum, const BoundingSpheres &spheres, size_t first, size_t last,
+                          uint32_t *visible)
+    {
+        __m128 px[6], py[6], pz[6], pw[6];
+        for (int p = 0; p < 6; p++)
+        {
+            px[p] = _mm_set1_ps(frustum.planes[p].x);
+            py[p] = _mm_set1_ps(frustum.planes[p].y);
+            pz[p] = _mm_set1_ps(frustum.planes[p].z);
+            pw[p] = _mm_set1_ps(frustum.planes[p].w);
+        }
+        const __m128 zero = _mm_setzero_ps();
+        size_t count = 0;
+        for (size_t i = first; i < last; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&spheres.x[i]);
+            __m128 y = _mm_loadu_ps(&spheres.y[i]);
+            __m128 z = _mm_loadu_ps(&spheres.z[i]);
+            __m128 r = _mm_loadu_ps(&spheres.radius[i]);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                                             _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+            }
+            // compact: one store per visible sphere
+            int mask = _mm_movemask_ps(inside);
+            while (mask)
+            {
+                visible[count++] = (uint32_t)(i + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+        return count;
+    }
+
+    // 8 spheres per iteration, built for AVX2 with FMA and picked at runtime.
+    // Each plane is three fused multiply-adds and a min, so the kernel is a
+    // chain of FMA-port work with no branches on visibility; stopping a block
+    // early once all 8 are out was slower, the branch mispredicts too often.
+    // FMA rounds once where the other kernels round twice, so a sphere within
+    // an ulp of a plane can be kept by one kernel and not another. Compaction
+    // stores all 8 lanes after moving the visible ones to the front with a
+    // permute picked by the lane mask, then advances by how many there were.
+    // ------------------------------------------------------------------------
+    __attribute__((target("avx2,fma")))
+    static size_t cullAVX2(const Frustum &frustum, const BoundingSpheres &spheres, size_t first, size_t last,
+                           uint32_t *visible)
+    {
+        const uint32_t (*permutes)[8] = compactPermutes();
+        __m256 px[6], py[6], pz[6], pw[6];
+        for (int p = 0; p < 6; p++)
+        {
+            px[p] = _mm256_set1_ps(frustum.planes[p].x);
+            py[p] = _mm256_set1_ps(frustum.planes[p].y);
+            pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+            pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+        }
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        size_t count = 0;
+        for (size_t i = first; i < last; i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+            __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+            __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+            // a sphere is inside when distance + radius >= 0 for every plane,
+            // which is the nearest plane's distance >= -radius
+            __m256 nearest = _mm256_fmadd_ps(px[0], x, _mm256_fmadd_ps(py[0], y, _mm256_fmadd_ps(pz[0], z, pw[0])));
+            for (int p = 1; p < 6; p++)
+                nearest = _mm256_min_ps(nearest, _mm256_fmadd_ps(px[p], x, _mm256_fmadd_ps(py[p], y, _mm256_fmadd_ps(pz[p], z, pw[p]))));
+            __m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(&spheres.radius[i]), signBit);
+            __m256 inside = _mm256_cmp_ps(nearest, negativeRadius, _CMP_GE_OQ);
+            int mask = _mm256_movemask_ps(inside);
+            __m256i indices = _mm256_add_epi32(_mm256_set1_epi32((int)i), lanes);
+            __m256i permute = _mm256_loadu_si256((const __m256i *)permutes[mask]);
+            _mm256_storeu_si256((__m256i *)(visible + count), _mm256_permutevar8x32_epi32(indices, permute));
+            count += __builtin_popcount(mask);
+        }
+        return count;
+    }
+
+private:
+    // for every 8 bit lane mask, the lanes that are set, in order
+    static const uint32_t (*compactPermutes())[8]
+    {
+        struct Table
+        {
+            uint32_t lanes[256][8];
+            Table()
+            {
+                for (int mask = 0; mask < 256; mask++)
+                {
+                    int n = 0;
+                    for (int lane = 0; lane < 8; lane++)
+                        if (mask & (1 << lane))
+                            lanes[mask][n++] = lane;
+                    while (n < 8)
+                        lanes[mask][n++] = 0;
+                }
+            }
+        };
+        static const Table table;
+        return table.lanes;
+    }
+#endif
+};
+#endif
@@ -0,0 +1,195 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// glad was generated for the 3.3 core API with no extensions. Everything newer
+// that we use is declared here in the same shape glad uses (glad_glFoo plus a
+// #define), and each block is skipped if a regenerated glad already has it.
+// Call loadGLExtensions with the same loader right after gladLoadGLLoader and
+// check the GLExt flags before using any of it.
+
+#ifndef APIENTRYP
+#define APIENTRYP APIENTRY *
+#endif
+
+// GL 4.1 / ARB_get_program_binary
+// ------------------------------------------------------------------------
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+inline PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary = NULL;
+#define glGetProgramBinary glad_glGetProgramBinary
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+inline PFNGLPROGRAMBINARYPROC glad_glProgramBinary = NULL;
+#define glProgramBinary glad_glProgramBinary
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+inline PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri = NULL;
+#define glProgramParameteri glad_glProgramParameteri
+#endif
+
+// GL 4.0 / ARB_draw_indirect, only the buffer target
+// ------------------------------------------------------------------------
+#ifndef GL_VERSION_4_0
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// GL 4.2 / ARB_texture_storage and ARB_base_instance
+// ------------------------------------------------------------------------
+#ifndef GL_VERSION_4_2
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+inline PFNGLTEXSTORAGE2DPROC glad_glTexStorage2D = NULL;
+#define glTexStorage2D glad_glTexStorage2D
+typedef void (APIENTRYP PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC)(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount, GLint basevertex, GLuint baseinstance);
+inline PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC glad_glDrawElementsInstancedBaseVertexBaseInstance = NULL;
+#define glDrawElementsInstancedBaseVertexBaseInstance glad_glDrawElementsInstancedBaseVertexBaseInstance
+#endif
+
+// GL 4.3 / ARB_shader_storage_buffer_object, ARB_program_interface_query,
+// ARB_multi_draw_indirect and ARB_vertex_attrib_binding
+// ------------------------------------------------------------------------
+#ifndef GL_VERSION_4_3
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BLOCK 0x92E6
+#define GL_MAX_SHADER_STORAGE_BLOCK_SIZE 0x90DE
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+typedef GLuint (APIENTRYP PFNGLGETPROGRAMRESOURCEINDEXPROC)(GLuint program, GLenum programInterface, const GLchar *name);
+inline PFNGLGETPROGRAMRESOURCEINDEXPROC glad_glGetProgramResourceIndex = NULL;
+#define glGetProgramResourceIndex glad_glGetProgramResourceIndex
+typedef void (APIENTRYP PFNGLSHADERSTORAGEBLOCKBINDINGPROC)(GLuint program, GLuint storageBlockIndex, GLuint storageBlockBinding);
+inline PFNGLSHADERSTORAGEBLOCKBINDINGPROC glad_glShaderStorageBlockBinding = NULL;
+#define glShaderStorageBlockBinding glad_glShaderStorageBlockBinding
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+inline PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect = NULL;
+#define glMultiDrawElementsIndirect glad_glMultiDrawElementsIndirect
+typedef void (APIENTRYP PFNGLBINDVERTEXBUFFERPROC)(GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+inline PFNGLBINDVERTEXBUFFERPROC glad_glBindVertexBuffer = NULL;
+#define glBindVertexBuffer glad_glBindVertexBuffer
+typedef void (APIENTRYP PFNGLVERTEXATTRIBFORMATPROC)(GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset);
+inline PFNGLVERTEXATTRIBFORMATPROC glad_glVertexAttribFormat = NULL;
+#define glVertexAttribFormat glad_glVertexAttribFormat
+typedef void (APIENTRYP PFNGLVERTEXATTRIBBINDINGPROC)(GLuint attribindex, GLuint bindingindex);
+inline PFNGLVERTEXATTRIBBINDINGPROC glad_glVertexAttribBinding = NULL;
+#define glVertexAttribBinding glad_glVertexAttribBinding
+#endif
+
+// GL 4.4 / ARB_buffer_storage
+// ------------------------------------------------------------------------
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+inline PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = NULL;
+#define glBufferStorage glad_glBufferStorage
+#endif
+
+// KHR_parallel_shader_compile (ARB_parallel_shader_compile uses the same tokens)
+// ------------------------------------------------------------------------
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+inline PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR = NULL;
+#define glMaxShaderCompilerThreadsKHR glad_glMaxShaderCompilerThreadsKHR
+#endif
+
+// capabilities of the current context, filled by loadGLExtensions
+struct GLExtensions
+{
+    int major = 3;
+    int minor = 3;
+    bool programBinary = false;
+    bool parallelShaderCompile = false;
+    bool textureStorage = false;
+    bool baseInstance = false;
+    bool shaderStorage = false;
+    bool bufferStorage = false;
+    bool multiDrawIndirect = false;
+    bool vertexAttribBinding = false;
+    // GLSL only: gl_BaseInstanceARB and gl_DrawIDARB (ARB_shader_draw_parameters, GL 4.6)
+    bool shaderDrawParameters = false;
+};
+inline GLExtensions GLExt;
+
+// true if the current context advertises the named extension
+// ------------------------------------------------------------------------
+inline bool hasGLExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (ext && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+inline bool hasGLVersion(int major, int minor)
+{
+    return GLExt.major > major || (GLExt.major == major && GLExt.minor >= minor);
+}
+
+// load the entry points above and record what the context supports
+// ------------------------------------------------------------------------
+inline void loadGLExtensions(GLADloadproc load)
+{
+    glGetIntegerv(GL_MAJOR_VERSION, &GLExt.major);
+    glGetIntegerv(GL_MINOR_VERSION, &GLExt.minor);
+#ifndef GL_VERSION_4_1
+    glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+    glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+    glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+#endif
+    GLExt.programBinary = (hasGLVersion(4, 1) || hasGLExtension("GL_ARB_get_program_binary"))
+        && glad_glGetProgramBinary && glad_glProgramBinary && glad_glProgramParameteri;
+#ifndef GL_VERSION_4_2
+    glad_glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)load("glTexStorage2D");
+#endif
+    GLExt.textureStorage = (hasGLVersion(4, 2) || hasGLExtension("GL_ARB_texture_storage")) && glad_glTexStorage2D;
+#ifndef GL_VERSION_4_2
+    glad_glDrawElementsInstancedBaseVertexBaseInstance = (PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC)load("glDrawElementsInstancedBaseVertexBaseInstance");
+#endif
+    GLExt.baseInstance = (hasGLVersion(4, 2) || hasGLExtension("GL_ARB_base_instance"))
+        && glad_glDrawElementsInstancedBaseVertexBaseInstance;
+#ifndef GL_VERSION_4_3
+    glad_glGetProgramResourceIndex = (PFNGLGETPROGRAMRESOURCEINDEXPROC)load("glGetProgramResourceIndex");
+    glad_glShaderStorageBlockBinding = (PFNGLSHADERSTORAGEBLOCKBINDINGPROC)load("glShaderStorageBlockBinding");
+#endif
+    GLExt.shaderStorage = (hasGLVersion(4, 3) || (hasGLExtension("GL_ARB_shader_storage_buffer_object")
+        && hasGLExtension("GL_ARB_program_interface_query")))
+        && glad_glGetProgramResourceIndex && glad_glShaderStorageBlockBinding;
+#ifndef GL_VERSION_4_3
+    glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+#endif
+    GLExt.multiDrawIndirect = (hasGLVersion(4, 3) || (hasGLExtension("GL_ARB_multi_draw_indirect")
+        && hasGLExtension("GL_ARB_draw_indirect"))) && glad_glMultiDrawElementsIndirect;
+#ifndef GL_VERSION_4_3
+    glad_glBindVertexBuffer = (PFNGLBINDVERTEXBUFFERPROC)load("glBindVertexBuffer");
+    glad_glVertexAttribFormat = (PFNGLVERTEXATTRIBFORMATPROC)load("glVertexAttribFormat");
+    glad_glVertexAttribBinding = (PFNGLVERTEXATTRIBBINDINGPROC)load("glVertexAttribBinding");
+#endif
+    GLExt.vertexAttribBinding = (hasGLVersion(4, 3) || hasGLExtension("GL_ARB_vertex_attrib_binding"))
+        && glad_glBindVertexBuffer && glad_glVertexAttribFormat && glad_glVertexAttribBinding;
+    GLExt.shaderDrawParameters = hasGLVersion(4, 6) || hasGLExtension("GL_ARB_shader_draw_parameters");
+#ifndef GL_VERSION_4_4
+    glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+#endif
+    GLExt.bufferStorage = (hasGLVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage")) && glad_glBufferStorage;
+#ifndef GL_KHR_parallel_shader_compile
+    glad_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+    if (!glad_glMaxShaderCompilerThreadsKHR)
+        glad_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+#endif
+    GLExt.parallelShaderCompile = hasGLExtension("GL_KHR_parallel_shader_compile")
+        || hasGLExtension("GL_ARB_parallel_shader_compile");
+}
+#endif
@@ -0,0 +1,315 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+
+// shadow copy of the GL state we change, so setting something that is
+// already set never reaches the driver. Everything that binds or toggles
+// tracked state must go through GLState; code that touches GL behind its
+// back must call invalidate() afterwards. Deleting a bound object unbinds it
+// in GL, so deletes are reported with the *Deleted calls.
+//
+// GL_ELEMENT_ARRAY_BUFFER is part of the bound VAO, not global state, so it
+// is passed straight through.
+// ------------------------------------------------------------------------
+class GLStateCache
+{
+public:
+    static const int MAX_TEXTURE_UNITS = 32;
+    // GL calls dropped as redundant so far
+    unsigned long skipped = 0;
+
+    GLStateCache()
+    {
+        invalidate();
+    }
+    // forget everything; the next call of each kind goes through
+    void invalidate()
+    {
+        program = vertexArray = UNKNOWN;
+        drawFramebuffer = readFramebuffer = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (GLuint &buffer : buffers)
+            buffer = UNKNOWN;
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+        {
+            for (int target = 0; target < TEXTURE_TARGETS; target++)
+                textures[unit][target] = UNKNOWN;
+            samplers[unit] = UNKNOWN;
+        }
+        for (Capability &capability : capabilities)
+            capability.state = -1;
+        blendSource = blendDestination = depthFunction = UNKNOWN;
+        depthWrite = -1;
+        viewportValid = clearColorValid = false;
+    }
+
+    // ------------------------------------------------------------------------
+    void useProgram(GLuint id)
+    {
+        if (changed(program, id))
+            glUseProgram(id);
+    }
+    void bindVertexArray(GLuint id)
+    {
+        if (changed(vertexArray, id))
+            glBindVertexArray(id);
+    }
+    void bindBuffer(GLenum target, GLuint id)
+    {
+        int index = bufferIndex(target);
+        if (index < 0 || changed(buffers[index], id))
+            glBindBuffer(target, id);
+    }
+    // indexed binds aren't cached, but they also set the generic binding
+    void bindBufferBase(GLenum target, GLuint index, GLuint id)
+    {
+        glBindBufferBase(target, index, id);
+        int generic = bufferIndex(target);
+        if (generic >= 0)
+            buffers[generic] = id;
+    }
+    void bindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size)
+    {
+        glBindBufferRange(target, index, id, offset, size);
+        int generic = bufferIndex(target);
+        if (generic >= 0)
+            buffers[generic] = id;
+    }
+    void bindFramebuffer(GLenum target, GLuint id)
+    {
+        if (target == GL_FRAMEBUFFER)
+        {
+            if (drawFramebuffer == id && readFramebuffer == id)
+            {
+                skipped++;
+                return;
+            }
+            drawFramebuffer = readFramebuffer = id;
+            glBindFramebuffer(target, id);
+        }
+        else if (changed(target == GL_DRAW_FRAMEBUFFER ? drawFramebuffer : readFramebuffer, id))
+            glBindFramebuffer(target, id);
+    }
+
+    // textures and samplers; unit is a GL_TEXTURE0 + i enum for activeTexture
+    // like glActiveTexture, a plain index everywhere else
+    // ------------------------------------------------------------------------
+    void activeTexture(GLenum unit)
+    {
+        if (changed(activeUnit, unit - GL_TEXTURE0))
+            glActiveTexture(unit);
+    }
+    // bind on the active unit
+    void bindTexture(GLenum target, GLuint id)
+    {
+        int index = textureIndex(target);
+        if (index < 0 || activeUnit >= MAX_TEXTURE_UNITS || changed(textures[activeUnit][index], id))
+            glBindTexture(target, id);
+    }
+    // bind on a given unit, switching the active unit only if the binding changes
+    void bindTextureUnit(GLuint unit, GLenum target, GLuint id)
+    {
+        int index = textureIndex(target);
+        if (index >= 0 && unit < MAX_TEXTURE_UNITS && textures[unit][index] == id)
+        {
+            skipped++;
+            return;
+        }
+        activeTexture(GL_TEXTURE0 + unit);
+        bindTexture(target, id);
+    }
+    void bindSampler(GLuint unit, GLuint id)
+    {
+        if (unit >= MAX_TEXTURE_UNITS || changed(samplers[unit], id))
+            glBindSampler(unit, id);
+    }
+
+    // fixed function state
+    // ------------------------------------------------------------------------
+    void setEnabled(GLenum cap, bool enabled)
+    {
+        for (Capability &capability : capabilities)
+        {
+            if (capability.cap != cap)
+                continue;
+            if (capability.state == (int)enabled)
+            {
+                skipped++;
+                return;
+            }
+            capability.state = enabled;
+            break;
+        }
+        if (enabled)
+            glEnable(cap);
+        else
+            glDisable(cap);
+    }
+    void enable(GLenum cap)
+    {
+        setEnabled(cap, true);
+    }
+    void disable(GLenum cap)
+    {
+        setEnabled(cap, false);
+    }
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        if (blendSource == source && blendDestination == destination)
+        {
+            skipped++;
+            return;
+        }
+        blendSource = source;
+        blendDestination = destination;
+        glBlendFunc(source, destination);
+    }
+    void depthFunc(GLenum function)
+    {
+        if (changed(depthFunction, function))
+            glDepthFunc(function);
+    }
+    void depthMask(bool write)
+    {
+        if (depthWrite == (int)write)
+        {
+            skipped++;
+            return;
+        }
+        depthWrite = write;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        if (viewportValid && viewportRect[0] == x && viewportRect[1] == y && viewportRect[2] == width && viewportRect[3] == height)
+        {
+            skipped++;
+            return;
+        }
+        viewportValid = true;
+        viewportRect[0] = x;
+        viewportRect[1] = y;
+        viewportRect[2] = width;
+        viewportRect[3] = height;
+        glViewport(x, y, width, height);
+    }
+    void clearColor(float r, float g, float b, float a)
+    {
+        if (clearColorValid && clear[0] == r && clear[1] == g && clear[2] == b && clear[3] == a)
+        {
+            skipped++;
+            return;
+        }
+        clearColorValid = true;
+        clear[0] = r;
+        clear[1] = g;
+        clear[2] = b;
+        clear[3] = a;
+        glClearColor(r, g, b, a);
+    }
+
+    // deleting a bound object resets that binding to 0
+    // ------------------------------------------------------------------------
+    void programDeleted(GLuint id)
+    {
+        forget(program, id);
+    }
+    void vertexArrayDeleted(GLuint id)
+    {
+        forget(vertexArray, id);
+    }
+    void bufferDeleted(GLuint id)
+    {
+        for (GLuint &buffer : buffers)
+            forget(buffer, id);
+    }
+    void textureDeleted(GLuint id)
+    {
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for (int target = 0; target < TEXTURE_TARGETS; target++)
+                forget(textures[unit][target], id);
+    }
+    void framebufferDeleted(GLuint id)
+    {
+        forget(drawFramebuffer, id);
+        forget(readFramebuffer, id);
+    }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    static const int BUFFER_TARGETS = 9;
+    static const int TEXTURE_TARGETS = 5;
+
+    struct Capability
+    {
+        GLenum cap;
+        int state;  // -1 unknown
+    };
+
+    GLuint program, vertexArray;
+    GLuint drawFramebuffer, readFramebuffer;
+    GLuint buffers[BUFFER_TARGETS];
+    GLuint activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLuint samplers[MAX_TEXTURE_UNITS];
+    Capability capabilities[6] = {
+        { GL_DEPTH_TEST, -1 }, { GL_BLEND, -1 }, { GL_CULL_FACE, -1 },
+        { GL_SCISSOR_TEST, -1 }, { GL_STENCIL_TEST, -1 }, { GL_FRAMEBUFFER_SRGB, -1 }
+    };
+    GLenum blendSource, blendDestination, depthFunction;
+    int depthWrite;
+    bool viewportValid, clearColorValid;
+    GLint viewportRect[4];
+    float clear[4];
+
+    // store value, true if it differs from what was there
+    bool changed(GLuint &current, GLuint value)
+    {
+        if (current == value)
+        {
+            skipped++;
+            return false;
+        }
+        current = value;
+        return true;
+    }
+    static void forget(GLuint &binding, GLuint id)
+    {
+        if (binding == id)
+            binding = 0;
+    }
+    static int bufferIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER:           return 0;
+        case GL_UNIFORM_BUFFER:         return 1;
+        case GL_COPY_READ_BUFFER:       return 2;
+        case GL_COPY_WRITE_BUFFER:      return 3;
+        case GL_PIXEL_PACK_BUFFER:      return 4;
+        case GL_PIXEL_UNPACK_BUFFER:    return 5;
+        case GL_TEXTURE_BUFFER:         return 6;
+        case GL_SHADER_STORAGE_BUFFER:  return 7;
+        case GL_DRAW_INDIRECT_BUFFER:   return 8;
+        default:                        return -1;
+        }
+    }
+    static int textureIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D:             return 0;
+        case GL_TEXTURE_2D_ARRAY:       return 1;
+        case GL_TEXTURE_CUBE_MAP:       return 2;
+        case GL_TEXTURE_3D:             return 3;
+        case GL_TEXTURE_BUFFER:         return 4;
+        default:                        return -1;
+        }
+    }
+};
+
+// the state of the one context the demo renders with
+inline GLStateCache GLState;
+#endif
@@ -0,0 +1,252 @@
+#ifndef GL_TRACE_H
+#define GL_TRACE_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+
+// GL call tracing for debug builds (make debug defines GL_TRACE). install()
+// swaps the glad function pointers of every entry point in
+// GL_TRACE_ENTRY_POINTS for a wrapper that counts the call, tallies uploaded
+// bytes, draws, triangles and state changes, then calls the real function.
+// Without GL_TRACE the macros are empty and none of this is compiled, so
+// release builds call the driver directly.
+//
+//   GL_TRACE_INSTALL();     once, after glad and loadGLExtensions
+//   GL_TRACE_BEGIN();       right before the render loop, so what setup
+//                           called is kept apart from the per-frame counts
+//   GL_TRACE_FRAME();       at the end of every frame
+#ifdef GL_TRACE
+#define GL_TRACE_INSTALL() GLTrace::install()
+#define GL_TRACE_BEGIN() GLTrace::begin()
+#define GL_TRACE_FRAME() GLTrace::endFrame()
+#else
+#define GL_TRACE_INSTALL() ((void)0)
+#define GL_TRACE_BEGIN() ((void)0)
+#define GL_TRACE_FRAME() ((void)0)
+#endif
+
+#ifdef GL_TRACE
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+// every entry point the demo calls; add new ones here to have them counted
+#define GL_TRACE_ENTRY_POINTS(X) \
+    X(glActiveTexture) X(glAttachShader) X(glBeginQuery) X(glBindBuffer) X(glBindBufferBase) X(glBindBufferRange) X(glBindFramebuffer) \
+    X(glBindRenderbuffer) X(glBindTexture) X(glBindVertexArray) X(glBufferData) X(glBufferSubData) \
+    X(glCheckFramebufferStatus) X(glClear) X(glClearColor) X(glCompileShader) X(glCreateProgram) \
+    X(glCreateShader) X(glDeleteBuffers) X(glDeleteFramebuffers) X(glDeleteQueries) X(glDeleteRenderbuffers) \
+    X(glDeleteShader) X(glDeleteTextures) X(glDeleteVertexArrays) X(glDetachShader) X(glDisable) \
+    X(glDrawArrays) X(glDrawArraysInstanced) X(glDrawElements) X(glDrawElementsInstanced) X(glDrawElementsInstancedBaseVertex) X(glEnable) \
+    X(glEnableVertexAttribArray) X(glEndQuery) X(glFinish) X(glFlush) X(glFramebufferRenderbuffer) \
+    X(glGenBuffers) X(glGenFramebuffers) X(glGenQueries) X(glGenRenderbuffers) X(glGenTextures) \
+    X(glGenVertexArrays) X(glGenerateMipmap) X(glGetActiveUniform) X(glGetIntegerv) X(glGetProgramInfoLog) \
+    X(glGetProgramiv) X(glGetQueryObjectui64v) X(glGetQueryObjectuiv) X(glGetShaderInfoLog) X(glGetShaderiv) \
+    X(glGetString) X(glGetUniformBlockIndex) X(glGetStringi) X(glGetUniformLocation) X(glLinkProgram) X(glPixelStorei) \
+    X(glQueryCounter) X(glReadPixels) X(glRenderbufferStorage) X(glShaderSource) X(glTexImage2D) \
+    X(glTexParameteri) X(glTexSubImage2D) X(glUniform1f) X(glUniform1i) X(glUniform2f) \
+    X(glUniform2fv) X(glUniform3f) X(glUniform3fv) X(glUniform4f) X(glUniform4fv) \
+    X(glUniformMatrix2fv) X(glUniformMatrix3fv) X(glUniformMatrix4fv) X(glUniformBlockBinding) X(glUseProgram) X(glVertexAttribDivisor) \
+    X(glVertexAttribPointer) X(glViewport) \
+    X(glTexBuffer) \
+    X(glGetProgramBinary) X(glProgramBinary) X(glProgramParameteri) X(glTexStorage2D) X(glMaxShaderCompilerThreadsKHR) \
+    X(glGetProgramResourceIndex) X(glShaderStorageBlockBinding) X(glDrawElementsInstancedBaseVertexBaseInstance) \
+    X(glMultiDrawElementsIndirect) \
+    X(glBufferStorage) X(glMapBufferRange) X(glFlushMappedBufferRange) X(glUnmapBuffer) \
+    X(glFenceSync) X(glClientWaitSync) X(glDeleteSync) \
+    X(glDrawElementsBaseVertex) X(glBindVertexBuffer) X(glVertexAttribFormat) X(glVertexAttribBinding) \
+    X(glFramebufferTexture2D) X(glBlitFramebuffer) X(glDrawBuffer) X(glDrawBuffers) \
+    X(glBindSampler) X(glBlendFunc) X(glDepthFunc) X(glDepthMask) X(glTexParameteriv)
+
+enum GLTraceEntry
+{
+#define GL_TRACE_ENUM(fn) GLTRACE_##fn,
+    GL_TRACE_ENTRY_POINTS(GL_TRACE_ENUM)
+#undef GL_TRACE_ENUM
+    GLTRACE_COUNT
+};
+
+// what one frame (or a whole run) did
+struct GLTraceCounters
+{
+    unsigned long calls[GLTRACE_COUNT] = {};
+    unsigned long totalCalls = 0;
+    uint64_t bytesUploaded = 0;     // glBuffer(Sub)Data/Storage and glTex(Sub)Image2D sources, not mapped writes
+    unsigned long drawCalls = 0;
+    uint64_t triangles = 0;         // across all instances, not counting indirect draws
+    unsigned long stateChanges = 0; // binds, program/VAO switches, enables, viewport...
+};
+
+class GLTrace
+{
+public:
+    // counters of the frame in progress, the last finished frame and every
+    // finished frame together; startup holds everything before begin()
+    static inline GLTraceCounters current, lastFrame, total, startup;
+    static inline unsigned long frames = 0;
+
+    static void install();
+
+    // moves what was counted so far into startup and starts frame 0 clean
+    static void begin()
+    {
+        startup = current;
+        current = lastFrame = total = GLTraceCounters();
+        frames = 0;
+    }
+
+    static void endFrame()
+    {
+        lastFrame = current;
+        for (int i = 0; i < GLTRACE_COUNT; i++)
+            total.calls[i] += current.calls[i];
+        total.totalCalls += current.totalCalls;
+        total.bytesUploaded += current.bytesUploaded;
+        total.drawCalls += current.drawCalls;
+        total.triangles += current.triangles;
+        total.stateChanges += current.stateChanges;
+        frames++;
+        current = GLTraceCounters();
+    }
+    static const char *name(int entry)
+    {
+        static const char *names[] = {
+#define GL_TRACE_NAME(fn) #fn,
+            GL_TRACE_ENTRY_POINTS(GL_TRACE_NAME)
+#undef GL_TRACE_NAME
+        };
+        return names[entry];
+    }
+    // summary plus the most called entry points, divided by frames (1 for a single frame)
+    static void print(const GLTraceCounters &counters, unsigned long frameCount, size_t top = 12,
+                      const char *label = "per frame")
+    {
+        double n = frameCount ? (double)frameCount : 1.0;
+        printf("gl %s: %.1f calls, %.1f draws, %.0f triangles, %.1f state changes, %.0f bytes uploaded\n",
+               label, counters.totalCalls / n, counters.drawCalls / n, counters.triangles / n,
+               counters.stateChanges / n, counters.bytesUploaded / n);
+        std::vector<int> order;
+        for (int i = 0; i < GLTRACE_COUNT; i++)
+            if (counters.calls[i])
+                order.push_back(i);
+        std::sort(order.begin(), order.end(),
+            [&counters](int a, int b) { return counters.calls[a] > counters.calls[b]; });
+        for (size_t i = 0; i < order.size() && i < top; i++)
+            printf("  %-28s %10.1f\n", name(order[i]), counters.calls[order[i]] / n);
+    }
+
+    // ------------------------------------------------------------------------
+    static uint64_t imageBytes(GLsizei width, GLsizei height, GLenum format, GLenum type)
+    {
+        int components = 4;
+        if (format == GL_RED || format == GL_DEPTH_COMPONENT)
+            components = 1;
+        else if (format == GL_RG)
+            components = 2;
+        else if (format == GL_RGB || format == GL_BGR)
+            components = 3;
+        int size = 1;
+        if (type == GL_UNSIGNED_SHORT || type == GL_SHORT || type == GL_HALF_FLOAT)
+            size = 2;
+        else if (type == GL_UNSIGNED_INT || type == GL_INT || type == GL_FLOAT)
+            size = 4;
+        return (uint64_t)width * height * components * size;
+    }
+    static uint64_t triangleCount(GLenum mode, GLsizei count)
+    {
+        if (mode == GL_TRIANGLES)
+            return count / 3;
+        if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count > 2)
+            return count - 2;
+        return 0;
+    }
+};
+
+// per-call bookkeeping beyond the call count, picked at compile time
+template<int Entry, typename Tuple>
+inline void glTraceAccount(const Tuple &args)
+{
+    GLTraceCounters &c = GLTrace::current;
+    using std::get;
+    if constexpr (Entry == GLTRACE_glBufferData || Entry == GLTRACE_glBufferStorage)
+        c.bytesUploaded += get<2>(args) ? (uint64_t)get<1>(args) : 0;
+    else if constexpr (Entry == GLTRACE_glBufferSubData)
+        c.bytesUploaded += (uint64_t)get<2>(args);
+    else if constexpr (Entry == GLTRACE_glTexImage2D)
+        c.bytesUploaded += get<8>(args) ? GLTrace::imageBytes(get<3>(args), get<4>(args), get<6>(args), get<7>(args)) : 0;
+    else if constexpr (Entry == GLTRACE_glTexSubImage2D)
+        c.bytesUploaded += GLTrace::imageBytes(get<4>(args), get<5>(args), get<6>(args), get<7>(args));
+    else if constexpr (Entry == GLTRACE_glDrawArrays)
+    {
+        c.drawCalls++;
+        c.triangles += GLTrace::triangleCount(get<0>(args), get<2>(args));
+    }
+    else if constexpr (Entry == GLTRACE_glDrawElements || Entry == GLTRACE_glDrawElementsBaseVertex)
+    {
+        c.drawCalls++;
+        c.triangles += GLTrace::triangleCount(get<0>(args), get<1>(args));
+    }
+    else if constexpr (Entry == GLTRACE_glDrawArraysInstanced)
+    {
+        c.drawCalls++;
+        c.triangles += GLTrace::triangleCount(get<0>(args), get<2>(args)) * get<3>(args);
+    }
+    else if constexpr (Entry == GLTRACE_glDrawElementsInstanced || Entry == GLTRACE_glDrawElementsInstancedBaseVertex
+                    || Entry == GLTRACE_glDrawElementsInstancedBaseVertexBaseInstance)
+    {
+        c.drawCalls++;
+        c.triangles += GLTrace::triangleCount(get<0>(args), get<1>(args)) * get<4>(args);
+    }
+    // the commands are in a GPU buffer, so only the submission is counted
+    else if constexpr (Entry == GLTRACE_glMultiDrawElementsIndirect)
+        c.drawCalls++;
+    else if constexpr (Entry == GLTRACE_glUseProgram || Entry == GLTRACE_glBindVertexArray
+                    || Entry == GLTRACE_glBindBuffer || Entry == GLTRACE_glBindBufferBase
+                    || Entry == GLTRACE_glBindBufferRange || Entry == GLTRACE_glBindVertexBuffer
+                    || Entry == GLTRACE_glBindTexture || Entry == GLTRACE_glBindSampler
+                    || Entry == GLTRACE_glActiveTexture || Entry == GLTRACE_glBindFramebuffer
+                    || Entry == GLTRACE_glBindRenderbuffer || Entry == GLTRACE_glEnable
+                    || Entry == GLTRACE_glDisable || Entry == GLTRACE_glViewport
+                    || Entry == GLTRACE_glClearColor || Entry == GLTRACE_glPixelStorei
+                    || Entry == GLTRACE_glBlendFunc || Entry == GLTRACE_glDepthFunc
+                    || Entry == GLTRACE_glDepthMask)
+        c.stateChanges++;
+}
+
+// one wrapper per entry point, generated from the glad pointer's type
+template<int Entry, typename Function>
+struct GLTraceHook;
+
+template<int Entry, typename Result, typename... Args>
+struct GLTraceHook<Entry, Result (APIENTRYP)(Args...)>
+{
+    static inline Result (APIENTRYP real)(Args...) = NULL;
+
+    static Result APIENTRY call(Args... args)
+    {
+        GLTrace::current.calls[Entry]++;
+        GLTrace::current.totalCalls++;
+        glTraceAccount<Entry>(std::forward_as_tuple(args...));
+        return real(args...);
+    }
+    static void install(Result (APIENTRYP &pointer)(Args...))
+    {
+        // entry points the context doesn't have stay NULL
+        if (pointer == NULL || pointer == call)
+            return;
+        real = pointer;
+        pointer = call;
+    }
+};
+
+inline void GLTrace::install()
+{
+#define GL_TRACE_INSTALL_ENTRY(fn) GLTraceHook<GLTRACE_##fn, decltype(glad_##fn)>::install(glad_##fn);
+    GL_TRACE_ENTRY_POINTS(GL_TRACE_INSTALL_ENTRY)
+#undef GL_TRACE_INSTALL_ENTRY
+}
+#endif
+#endif
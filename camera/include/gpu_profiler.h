@@ -0,0 +1,278 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+
+// GPU time per named pass. Every pass boundary is a GL_TIMESTAMP query, so
+// passes can nest (GL_TIME_ELAPSED queries can't, and the benchmark's frame
+// timer already holds that target). Queries are issued into one of LATENCY
+// frame slots and a slot is only read back when it comes around again, by
+// which time the GPU has long finished it; if it hasn't, that frame's results
+// are dropped rather than waited for, so the CPU never stalls on the profiler.
+//
+//   profiler.beginFrame();
+//   profiler.beginPass("cubes"); ...draws... profiler.endPass();
+//   profiler.endFrame();
+// ------------------------------------------------------------------------
+class GpuProfiler
+{
+public:
+    static const int LATENCY = 4;
+    // rolling statistics cover this many of the most recent frames
+    static const int WINDOW = 120;
+
+    struct PassStats
+    {
+        std::string name;
+        int depth = 0;
+        double lastMs = 0.0, averageMs = 0.0, minMs = 0.0, maxMs = 0.0;
+        unsigned long samples = 0;
+        std::vector<double> history;
+    };
+
+    bool enabled = false;
+
+    void destroy()
+    {
+        for (FrameSlot &slot : frames)
+        {
+            if (!slot.queries.empty())
+                glDeleteQueries((GLsizei)slot.queries.size(), slot.queries.data());
+            slot.queries.clear();
+        }
+    }
+
+    // starts the implicit "frame" pass that encloses everything else
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        if (!enabled)
+            return;
+        FrameSlot &slot = frames[frameIndex % LATENCY];
+        if (slot.pending)
+            resolve(slot);
+        slot.used = 0;
+        slot.records.clear();
+        beginPass("frame");
+    }
+    void endFrame()
+    {
+        if (!enabled)
+            return;
+        while (!stack.empty())
+            endPass();
+        frames[frameIndex % LATENCY].pending = true;
+        frameIndex++;
+    }
+    // ------------------------------------------------------------------------
+    void beginPass(const char *name)
+    {
+        if (!enabled)
+            return;
+        FrameSlot &slot = frames[frameIndex % LATENCY];
+        Record record;
+        record.pass = passIndex(name);
+        record.begin = nextQuery(slot);
+        record.end = 0;
+        glQueryCounter(record.begin, GL_TIMESTAMP);
+        stack.push_back(slot.records.size());
+        slot.records.push_back(record);
+    }
+    void endPass()
+    {
+        if (!enabled || stack.empty())
+            return;
+        FrameSlot &slot = frames[frameIndex % LATENCY];
+        Record &record = slot.records[stack.back()];
+        stack.pop_back();
+        record.end = nextQuery(slot);
+        glQueryCounter(record.end, GL_TIMESTAMP);
+    }
+
+    // read back every frame still in flight, waiting for the GPU; for the end
+    // of a run, before the final dump
+    // ------------------------------------------------------------------------
+    void flush()
+    {
+        if (!enabled)
+            return;
+        for (unsigned long i = 0; i < LATENCY; i++)
+        {
+            FrameSlot &slot = frames[(frameIndex + i) % LATENCY];
+            if (slot.pending)
+                resolve(slot, true);
+        }
+    }
+
+    // every pass seen so far, in first-seen order (parents before children)
+    // ------------------------------------------------------------------------
+    const std::vector<PassStats> &passes() const
+    {
+        return stats;
+    }
+    // NULL if no pass by that name has been timed
+    const PassStats *find(const std::string &name) const
+    {
+        auto it = passIds.find(name);
+        return it == passIds.end() ? NULL : &stats[it->second];
+    }
+    unsigned long framesResolved() const
+    {
+        return resolvedFrames;
+    }
+    unsigned long framesDropped() const
+    {
+        return droppedFrames;
+    }
+
+    // write the per-pass statistics as JSON
+    // ------------------------------------------------------------------------
+    bool dump(const std::string &path) const
+    {
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cout << "ERROR::GPU_PROFILER::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        fprintf(file, "{\n  \"frames\": %lu,\n  \"dropped_frames\": %lu,\n  \"window\": %d,\n  \"passes\": [\n",
+                resolvedFrames, droppedFrames, WINDOW);
+        for (size_t i = 0; i < stats.size(); i++)
+        {
+            const PassStats &pass = stats[i];
+            fprintf(file, "    { \"name\": \"%s\", \"depth\": %d, \"last_ms\": %.4f, \"avg_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f, \"samples\": %lu }%s\n",
+                    pass.name.c_str(), pass.depth, pass.lastMs, pass.averageMs, pass.minMs, pass.maxMs, pass.samples,
+                    i + 1 < stats.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+        return fclose(file) == 0;
+    }
+    // the same as an indented table on stdout
+    void print() const
+    {
+        printf("%-24s %9s %9s %9s %9s\n", "gpu pass", "last ms", "avg ms", "min ms", "max ms");
+        for (const PassStats &pass : stats)
+            printf("%*s%-*s %9.3f %9.3f %9.3f %9.3f\n", pass.depth * 2, "", 24 - pass.depth * 2, pass.name.c_str(),
+                   pass.lastMs, pass.averageMs, pass.minMs, pass.maxMs);
+    }
+
+private:
+    struct Record
+    {
+        int pass;
+        GLuint begin, end;
+    };
+    struct FrameSlot
+    {
+        // query objects are created on demand and reused every LATENCY frames
+        std::vector<GLuint> queries;
+        size_t used = 0;
+        std::vector<Record> records;
+        bool pending = false;
+    };
+
+    FrameSlot frames[LATENCY];
+    unsigned long frameIndex = 0, resolvedFrames = 0, droppedFrames = 0;
+    std::vector<size_t> stack;
+    std::vector<PassStats> stats;
+    std::unordered_map<std::string, int> passIds;
+    std::vector<double> frameTotals;
+
+    GLuint nextQuery(FrameSlot &slot)
+    {
+        if (slot.used == slot.queries.size())
+        {
+            GLuint query;
+            glGenQueries(1, &query);
+            slot.queries.push_back(query);
+        }
+        return slot.queries[slot.used++];
+    }
+    int passIndex(const char *name)
+    {
+        auto it = passIds.find(name);
+        if (it != passIds.end())
+            return it->second;
+        PassStats pass;
+        pass.name = name;
+        pass.depth = (int)stack.size();
+        stats.push_back(pass);
+        passIds.emplace(name, (int)stats.size() - 1);
+        return (int)stats.size() - 1;
+    }
+    // read a finished slot back, or drop it if the GPU is still behind
+    void resolve(FrameSlot &slot, bool wait = false)
+    {
+        slot.pending = false;
+        if (slot.records.empty())
+            return;
+        // timestamps complete in order, so the frame's last query covers all of them
+        GLuint available = 0;
+        glGetQueryObjectuiv(slot.records[0].end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !wait)
+        {
+            droppedFrames++;
+            return;
+        }
+        // a pass may run several times a frame; its sample is the sum
+        frameTotals.assign(stats.size(), -1.0);
+        for (const Record &record : slot.records)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(record.begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(record.end, GL_QUERY_RESULT, &end);
+            double ms = end > begin ? (double)(end - begin) * 1e-6 : 0.0;
+            frameTotals[record.pass] = std::max(frameTotals[record.pass], 0.0) + ms;
+        }
+        for (size_t i = 0; i < frameTotals.size(); i++)
+            if (frameTotals[i] >= 0.0)
+                addSample(stats[i], frameTotals[i]);
+        resolvedFrames++;
+    }
+    static void addSample(PassStats &pass, double ms)
+    {
+        if (pass.history.size() < (size_t)WINDOW)
+            pass.history.push_back(ms);
+        else
+            pass.history[pass.samples % WINDOW] = ms;
+        pass.samples++;
+        pass.lastMs = ms;
+        double sum = 0.0;
+        pass.minMs = pass.maxMs = ms;
+        for (double sample : pass.history)
+        {
+            sum += sample;
+            pass.minMs = std::min(pass.minMs, sample);
+            pass.maxMs = std::max(pass.maxMs, sample);
+        }
+        pass.averageMs = sum / pass.history.size();
+    }
+};
+
+// times the enclosing scope as a pass
+// ------------------------------------------------------------------------
+class GpuZone
+{
+public:
+    GpuZone(GpuProfiler &profiler, const char *name) : profiler(profiler)
+    {
+        profiler.beginPass(name);
+    }
+    ~GpuZone()
+    {
+        profiler.endPass();
+    }
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+    GpuProfiler &profiler;
+};
+#endif
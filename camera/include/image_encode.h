@@ -0,0 +1,274 @@
+#ifndef IMAGE_ENCODE_H
+#define IMAGE_ENCODE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define IMAGE_ENCODE_SSE2 1
+#endif
+
+// encoders for frames read back from GL: RGBA8, bottom row first, as
+// glReadPixels returns them. Both write top row first.
+// ------------------------------------------------------------------------
+class ImageEncode
+{
+public:
+    // a PNG with 8-bit RGB and no compression: the zlib stream uses stored
+    // blocks, so there is nothing to link and a 1080p frame costs two
+    // checksums and a copy. Bigger files than a real deflate, but every PNG
+    // reader takes them.
+    // ------------------------------------------------------------------------
+    static bool writePng(FILE *file, const uint8_t *rgba, int width, int height)
+    {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        if (fwrite(signature, 1, 8, file) != 8)
+            return false;
+
+        uint8_t header[13];
+        putBig32(header, (uint32_t)width);
+        putBig32(header + 4, (uint32_t)height);
+        header[8] = 8;      // bits per channel
+        header[9] = 2;      // RGB
+        header[10] = 0;     // deflate
+        header[11] = 0;     // adaptive filtering, every row filter 0 here
+        header[12] = 0;     // not interlaced
+        if (!writeChunk(file, "IHDR", header, sizeof(header)))
+            return false;
+
+        // filter byte + RGB per row, split into stored blocks of at most 65535
+        size_t rowBytes = 1 + (size_t)width * 3;
+        size_t rawBytes = rowBytes * height;
+        size_t blocks = (rawBytes + 65534) / 65535;
+        std::vector<uint8_t> data(2 + rawBytes + blocks * 5 + 4);
+        uint8_t *out = data.data();
+        *out++ = 0x78;      // deflate, 32K window
+        *out++ = 0x01;      // no preset dictionary, fastest
+        std::vector<uint8_t> row(rowBytes);
+        uint32_t adlerA = 1, adlerB = 0;
+        size_t blockLeft = 0, rawLeft = rawBytes;
+        for (int y = height - 1; y >= 0; y--)
+        {
+            row[0] = 0;
+            const uint8_t *src = rgba + (size_t)y * width * 4;
+            for (int x = 0; x < width; x++)
+                memcpy(&row[1 + (size_t)x * 3], &src[(size_t)x * 4], 3);
+            adler32(row.data(), rowBytes, adlerA, adlerB);
+            size_t copied = 0;
+            while (copied < rowBytes)
+            {
+                if (blockLeft == 0)
+                {
+                    blockLeft = rawLeft < 65535 ? rawLeft : 65535;
+                    *out++ = blockLeft == rawLeft ? 1 : 0;     // BFINAL, BTYPE stored
+                    *out++ = (uint8_t)(blockLeft & 0xFF);
+                    *out++ = (uint8_t)(blockLeft >> 8);
+                    *out++ = (uint8_t)(~blockLeft & 0xFF);
+                    *out++ = (uint8_t)((~blockLeft >> 8) & 0xFF);
+                }
+                size_t n = rowBytes - copied < blockLeft ? rowBytes - copied : blockLeft;
+                memcpy(out, &row[copied], n);
+                out += n;
+                copied += n;
+                blockLeft -= n;
+                rawLeft -= n;
+            }
+        }
+        putBig32(out, (adlerB << 16) | adlerA);
+        out += 4;
+        if (!writeChunk(file, "IDAT", data.data(), (size_t)(out - data.data())))
+            return false;
+        return writeChunk(file, "IEND", NULL, 0);
+    }
+
+    // full range BT.601 4:2:0 (Y4M's C420jpeg): a Y plane of width x height
+    // and U and V planes of half size, rounded up. Chroma is taken from the
+    // average of each 2x2 block.
+    // ------------------------------------------------------------------------
+    static void rgbaToYuv420(const uint8_t *rgba, int width, int height, uint8_t *yPlane, uint8_t *uPlane, uint8_t *vPlane)
+    {
+        int chromaWidth = (width + 1) / 2;
+        for (int y = 0; y < height; y += 2)
+        {
+            // output row y is input row height - 1 - y
+            const uint8_t *row0 = rgba + (size_t)(height - 1 - y) * width * 4;
+            const uint8_t *row1 = y + 1 < height ? row0 - (size_t)width * 4 : row0;
+            uint8_t *y0 = yPlane + (size_t)y * width;
+            uint8_t *y1 = y + 1 < height ? y0 + width : NULL;
+            uint8_t *u = uPlane + (size_t)(y / 2) * chromaWidth;
+            uint8_t *v = vPlane + (size_t)(y / 2) * chromaWidth;
+            int x = 0;
+#ifdef IMAGE_ENCODE_SSE2
+            x = rowPairSSE2(row0, row1, width, y0, y1, u, v);
+#endif
+            rowPairScalar(row0, row1, x, width, y0, y1, u, v);
+        }
+    }
+
+private:
+    static void putBig32(uint8_t *out, uint32_t value)
+    {
+        out[0] = (uint8_t)(value >> 24);
+        out[1] = (uint8_t)(value >> 16);
+        out[2] = (uint8_t)(value >> 8);
+        out[3] = (uint8_t)value;
+    }
+    static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size)
+    {
+        struct Table
+        {
+            uint32_t entries[256];
+            Table()
+            {
+                for (uint32_t n = 0; n < 256; n++)
+                {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++)
+                        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    entries[n] = c;
+                }
+            }
+        };
+        static const Table table;
+        for (size_t i = 0; i < size; i++)
+            crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return crc;
+    }
+    static void adler32(const uint8_t *data, size_t size, uint32_t &a, uint32_t &b)
+    {
+        // 5552 bytes is the most that can be summed before b could overflow
+        while (size > 0)
+        {
+            size_t n = size < 5552 ? size : 5552;
+            size -= n;
+            while (n--)
+            {
+                a += *data++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+    }
+    static bool writeChunk(FILE *file, const char *type, const uint8_t *data, size_t size)
+    {
+        uint8_t length[4], crcBytes[4];
+        putBig32(length, (uint32_t)size);
+        uint32_t crc = crc32(0xFFFFFFFFu, (const uint8_t *)type, 4);
+        if (size)
+            crc = crc32(crc, data, size);
+        putBig32(crcBytes, crc ^ 0xFFFFFFFFu);
+        return fwrite(length, 1, 4, file) == 4 && fwrite(type, 1, 4, file) == 4
+            && (size == 0 || fwrite(data, 1, size, file) == size) && fwrite(crcBytes, 1, 4, file) == 4;
+    }
+
+    // 8-bit fixed point: Y = (77 R + 150 G + 29 B) / 256,
+    // U = (-43 R - 85 G + 128 B) / 256 + 128, V = (128 R - 107 G - 21 B) / 256 + 128
+    static uint8_t luma(const uint8_t *p)
+    {
+        return (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+    static void rowPairScalar(const uint8_t *row0, const uint8_t *row1, int x, int width,
+                              uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v)
+    {
+        for (; x < width; x += 2)
+        {
+            int x1 = x + 1 < width ? x + 1 : x;
+            const uint8_t *p[4] = { row0 + x * 4, row0 + x1 * 4, row1 + x * 4, row1 + x1 * 4 };
+            y0[x] = luma(p[0]);
+            if (x + 1 < width)
+                y0[x + 1] = luma(p[1]);
+            if (y1)
+            {
+                y1[x] = luma(p[2]);
+                if (x + 1 < width)
+                    y1[x + 1] = luma(p[3]);
+            }
+            int r = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+            int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+            int b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+            // sums of four: divide by 1024 instead of 256
+            u[x / 2] = (uint8_t)(((-43 * r - 85 * g + 128 * b + 512) >> 10) + 128);
+            v[x / 2] = (uint8_t)(((128 * r - 107 * g - 21 * b + 512) >> 10) + 128);
+        }
+    }
+
+#ifdef IMAGE_ENCODE_SSE2
+    // the weighted sum of each pixel's R, G and B in 16-bit lanes RGBA RGBA,
+    // as two 32-bit results in lanes 0 and 2
+    static __m128i weigh(__m128i pixels, __m128i weights)
+    {
+        __m128i pairs = _mm_madd_epi16(pixels, weights);
+        return _mm_add_epi32(pairs, _mm_srli_epi64(pairs, 32));
+    }
+    // two 32-bit results in lanes 0 and 2 of a and b -> four in order
+    static __m128i gather(__m128i a, __m128i b)
+    {
+        return _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    // four pixels of luma from 16 bytes of RGBA
+    static __m128i luma4(__m128i rgba, __m128i weights)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_unpacklo_epi8(rgba, zero);
+        __m128i hi = _mm_unpackhi_epi8(rgba, zero);
+        __m128i sum = gather(weigh(lo, weights), weigh(hi, weights));
+        return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+    }
+    // 8 pixels of two rows per iteration: 16 luma, 4 chroma pairs. Returns
+    // where the scalar loop takes over.
+    // ------------------------------------------------------------------------
+    static int rowPairSSE2(const uint8_t *row0, const uint8_t *row1, int width,
+                           uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i yWeights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+        const __m128i uWeights = _mm_setr_epi16(-43, -85, 128, 0, -43, -85, 128, 0);
+        const __m128i vWeights = _mm_setr_epi16(128, -107, -21, 0, 128, -107, -21, 0);
+        const __m128i chromaRound = _mm_set1_epi32(512);
+        const __m128i chromaBias = _mm_set1_epi32(128);
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + x * 4));
+            __m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + x * 4 + 16));
+            __m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + x * 4));
+            __m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + x * 4 + 16));
+
+            __m128i lumaA = _mm_packs_epi32(luma4(a0, yWeights), luma4(a1, yWeights));
+            _mm_storel_epi64((__m128i *)(y0 + x), _mm_packus_epi16(lumaA, zero));
+            if (y1)
+            {
+                __m128i lumaB = _mm_packs_epi32(luma4(b0, yWeights), luma4(b1, yWeights));
+                _mm_storel_epi64((__m128i *)(y1 + x), _mm_packus_epi16(lumaB, zero));
+            }
+
+            // per 2x2 block: add the rows, then each pixel to its neighbour
+            __m128i sums[2];
+            __m128i rows[2][2] = { { a0, b0 }, { a1, b1 } };
+            for (int half = 0; half < 2; half++)
+            {
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(rows[half][0], zero), _mm_unpacklo_epi8(rows[half][1], zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(rows[half][0], zero), _mm_unpackhi_epi8(rows[half][1], zero));
+                lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+                sums[half] = _mm_unpacklo_epi64(lo, hi);    // two blocks, RGBA each
+            }
+            __m128i uSum = gather(weigh(sums[0], uWeights), weigh(sums[1], uWeights));
+            __m128i vSum = gather(weigh(sums[0], vWeights), weigh(sums[1], vWeights));
+            __m128i u4 = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(uSum, chromaRound), 10), chromaBias);
+            __m128i v4 = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(vSum, chromaRound), 10), chromaBias);
+            __m128i uv = _mm_packus_epi16(_mm_packs_epi32(u4, v4), zero);
+            uint32_t uBytes = (uint32_t)_mm_cvtsi128_si32(uv);
+            uint32_t vBytes = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(uv, 4));
+            memcpy(u + x / 2, &uBytes, 4);
+            memcpy(v + x / 2, &vBytes, 4);
+        }
+        return x;
+    }
+#endif
+};
+#endif
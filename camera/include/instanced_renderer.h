@@ -0,0 +1,100 @@
+#ifndef INSTANCED_RENDERER_H
+#define INSTANCED_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "cpu_profiler.h"
+#include "gl_state.h"
+
+#include <cstddef>
+#include <vector>
+
+// per-instance transform as position plus rotation, 32 bytes instead of a
+// 64 byte matrix. The vertex shader (src/instanced.vs) builds the model
+// matrix: translate(position) * rotate(angle + angularSpeed * time, axis) * scale.
+struct Instance
+{
+    glm::vec3 position;
+    float scale;
+    glm::vec3 axis;
+    float angle;
+};
+
+// draws one mesh many times with a single instanced draw call. Instance data
+// lives in its own VBO attached to the mesh's VAO with a divisor of 1, so the
+// CPU cost per frame is the same for 10 instances as for a million; the buffer
+// is only rewritten when instances change.
+class InstancedRenderer
+{
+public:
+    GLuint VBO = 0;
+
+    // add the instance attributes to vao, whose per-vertex attributes are
+    // already set up; they take locations firstLocation and firstLocation + 1
+    // ------------------------------------------------------------------------
+    void init(GLuint vao, GLuint firstLocation = 2)
+    {
+        VAO = vao;
+        glGenBuffers(1, &VBO);
+        GLState.bindVertexArray(VAO);
+        GLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        // xyz position, w uniform scale
+        glVertexAttribPointer(firstLocation, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, position));
+        glEnableVertexAttribArray(firstLocation);
+        glVertexAttribDivisor(firstLocation, 1);
+        // xyz rotation axis, w angle
+        glVertexAttribPointer(firstLocation + 1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, axis));
+        glEnableVertexAttribArray(firstLocation + 1);
+        glVertexAttribDivisor(firstLocation + 1, 1);
+        GLState.bindVertexArray(0);
+    }
+    // replace every instance; glBufferData orphans the old storage so an
+    // in-flight draw never makes this wait
+    // ------------------------------------------------------------------------
+    void setInstances(const Instance *instances, size_t count)
+    {
+        PROFILE_ZONE("InstancedRenderer::setInstances");
+        GLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(Instance), instances, GL_STATIC_DRAW);
+        numInstances = count;
+    }
+    void setInstances(const std::vector<Instance> &instances)
+    {
+        setInstances(instances.data(), instances.size());
+    }
+    // rewrite a range of instances in place
+    // ------------------------------------------------------------------------
+    void updateInstances(size_t first, const Instance *instances, size_t count)
+    {
+        PROFILE_ZONE("InstancedRenderer::updateInstances");
+        GLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Instance), count * sizeof(Instance), instances);
+    }
+    // draw every instance of a non-indexed mesh
+    // ------------------------------------------------------------------------
+    void drawArrays(GLenum mode, GLint first, GLsizei vertexCount) const
+    {
+        if (numInstances == 0)
+            return;
+        GLState.bindVertexArray(VAO);
+        glDrawArraysInstanced(mode, first, vertexCount, (GLsizei)numInstances);
+    }
+    // draw every instance of an indexed mesh, the VAO's element buffer is used
+    // ------------------------------------------------------------------------
+    void drawElements(GLenum mode, GLsizei indexCount, GLenum type, const void *indices) const
+    {
+        if (numInstances == 0)
+            return;
+        GLState.bindVertexArray(VAO);
+        glDrawElementsInstanced(mode, indexCount, type, indices, (GLsizei)numInstances);
+    }
+    size_t instanceCount() const
+    {
+        return numInstances;
+    }
+
+private:
+    GLuint VAO = 0;
+    size_t numInstances = 0;
+};
+#endif
@@ -0,0 +1,347 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include "cpu_profiler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+class JobCounter;
+
+// a queued piece of work and the counter it reports to
+struct Job
+{
+    std::function<void()> task;
+    JobCounter *counter;
+};
+
+// counts unfinished jobs. run() adds one per job and each finished job takes
+// one off; JobSystem::wait() returns once it is back to zero. Jobs queued
+// with runAfter() start when their counter reaches zero, which is how
+// dependencies are expressed: queue all of a counter's own jobs before
+// anything runs after it. Reusable, or destroyable, once wait() returns.
+// ------------------------------------------------------------------------
+class JobCounter
+{
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool done() const
+    {
+        return value.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> value{0};
+    std::mutex continuationMutex;
+    std::vector<Job*> continuations;
+};
+
+// Chase-Lev work stealing deque of fixed capacity. The owning thread pushes
+// and pops at the bottom, like a stack, so it keeps working on what it just
+// split off while that is still in cache; any other thread steals the
+// oldest job from the top.
+// ------------------------------------------------------------------------
+template <typename T>
+class WorkStealingDeque
+{
+public:
+    static const int64_t CAPACITY = 4096;
+
+    WorkStealingDeque()
+    {
+        for (std::atomic<T*> &slot : slots)
+            slot.store(nullptr, std::memory_order_relaxed);
+    }
+    // owner only, false when full
+    bool push(T *item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= CAPACITY)
+            return false;
+        slots[b & (CAPACITY - 1)].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+    // owner only, the newest item or NULL
+    T *pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T *item = slots[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // the last item: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                item = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+    // any thread, the oldest item or NULL (also when losing a race)
+    T *steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+        T *item = slots[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return item;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<T*> slots[CAPACITY];
+};
+
+// a pool of workers, one work stealing deque each, for per-frame CPU work.
+// The thread that creates the system is worker 0: it owns a deque too and
+// runs jobs while it waits, so nothing blocks on the main thread and a
+// system with one thread runs everything inline. Idle workers spin briefly
+// and then sleep until more work is queued.
+//
+// Jobs must never make GL calls: only the thread owning the context may.
+// Split the work so jobs fill CPU-side arrays and the main thread uploads
+// them afterwards.
+// ------------------------------------------------------------------------
+class JobSystem
+{
+public:
+    // threads = 0 uses one per hardware thread, the calling thread included
+    explicit JobSystem(unsigned int threads = 0)
+    {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+        queues.reserve(threads);
+        for (unsigned int i = 0; i < threads; i++)
+            queues.emplace_back(new WorkStealingDeque<Job>());
+        workerIndex() = 0;
+        for (unsigned int i = 1; i < threads; i++)
+            workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+        for (WorkStealingDeque<Job> *queue : queues)
+            delete queue;
+    }
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned int threadCount() const
+    {
+        return (unsigned int)queues.size();
+    }
+
+    // queue a job; counter, if given, is counted up now and down when it is done
+    // ------------------------------------------------------------------------
+    void run(std::function<void()> task, JobCounter *counter = nullptr)
+    {
+        if (counter)
+            counter->value.fetch_add(1, std::memory_order_relaxed);
+        submit(new Job{ std::move(task), counter });
+    }
+    // queue a job that starts only once dependency is done
+    void runAfter(JobCounter &dependency, std::function<void()> task, JobCounter *counter = nullptr)
+    {
+        if (counter)
+            counter->value.fetch_add(1, std::memory_order_relaxed);
+        Job *job = new Job{ std::move(task), counter };
+        {
+            std::lock_guard<std::mutex> lock(dependency.continuationMutex);
+            if (!dependency.done())
+            {
+                dependency.continuations.push_back(job);
+                return;
+            }
+        }
+        submit(job);
+    }
+    // run other jobs until counter is zero
+    // ------------------------------------------------------------------------
+    void wait(JobCounter &counter)
+    {
+        PROFILE_ZONE("JobSystem::wait");
+        int index = workerIndex();
+        while (!counter.done())
+        {
+            Job *job = find(index);
+            if (job)
+                execute(job);
+            else
+                std::this_thread::yield();
+        }
+        // the last job may still be unlocking; after this the counter can go
+        { std::lock_guard<std::mutex> lock(counter.continuationMutex); }
+    }
+    // call body(begin, end) over [first, last) in chunks of at most grain
+    // items, spread over every worker, and return when all are done
+    // ------------------------------------------------------------------------
+    template <typename Body>
+    void parallelFor(size_t first, size_t last, size_t grain, const Body &body)
+    {
+        if (first >= last)
+            return;
+        if (grain == 0)
+            grain = 1;
+        if (last - first <= grain || threadCount() == 1)
+        {
+            body(first, last);
+            return;
+        }
+        JobCounter counter;
+        for (size_t begin = first; begin < last; begin += grain)
+        {
+            size_t end = begin + grain < last ? begin + grain : last;
+            run([&body, begin, end]() { body(begin, end); }, &counter);
+        }
+        wait(counter);
+    }
+    // a grain that splits count items into a few chunks per worker
+    size_t grainFor(size_t count, size_t minimum = 256) const
+    {
+        size_t grain = count / (threadCount() * 4) + 1;
+        return grain < minimum ? minimum : grain;
+    }
+
+private:
+    std::vector<WorkStealingDeque<Job>*> queues;
+    std::vector<std::thread> workers;
+    // jobs queued by threads that aren't workers, or that found their deque full
+    std::mutex injectedMutex;
+    std::deque<Job*> injected;
+    // queued and not yet taken by anyone, so sleepers know when to wake
+    std::atomic<int> pending{0};
+    std::atomic<int> sleeping{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // -1 on threads that aren't workers of any system
+    static int &workerIndex()
+    {
+        thread_local int index = -1;
+        return index;
+    }
+
+    void submit(Job *job)
+    {
+        int index = workerIndex();
+        pending.fetch_add(1);
+        if (index < 0 || index >= (int)queues.size() || !queues[index]->push(job))
+        {
+            std::lock_guard<std::mutex> lock(injectedMutex);
+            injected.push_back(job);
+        }
+        if (sleeping.load() > 0)
+        {
+            // taking the lock orders this after a sleeper's last look at pending
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            wake.notify_one();
+        }
+    }
+    // own deque first, then the shared queue, then steal from the others
+    Job *find(int index)
+    {
+        Job *job = nullptr;
+        if (index >= 0 && index < (int)queues.size())
+            job = queues[index]->pop();
+        if (!job)
+        {
+            std::lock_guard<std::mutex> lock(injectedMutex);
+            if (!injected.empty())
+            {
+                job = injected.front();
+                injected.pop_front();
+            }
+        }
+        for (size_t i = 1; !job && i <= queues.size(); i++)
+        {
+            size_t victim = (index + i) % queues.size();
+            if ((int)victim != index)
+                job = queues[victim]->steal();
+        }
+        if (job)
+            pending.fetch_sub(1);
+        return job;
+    }
+    void execute(Job *job)
+    {
+        job->task();
+        JobCounter *counter = job->counter;
+        delete job;
+        if (!counter)
+            return;
+        // count down under the lock, so runAfter() either sees the counter
+        // done or has its job in the list before the last job takes it
+        std::vector<Job*> ready;
+        {
+            std::lock_guard<std::mutex> lock(counter->continuationMutex);
+            if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready.swap(counter->continuations);
+        }
+        for (Job *next : ready)
+            submit(next);
+    }
+    void workerLoop(unsigned int index)
+    {
+        workerIndex() = (int)index;
+        PROFILE_THREAD("job worker");
+        int idle = 0;
+        while (true)
+        {
+            Job *job = find((int)index);
+            if (job)
+            {
+                execute(job);
+                idle = 0;
+                continue;
+            }
+            if (++idle < 64)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping.fetch_add(1);
+            wake.wait(lock, [this]() { return stopping || pending.load() > 0; });
+            sleeping.fetch_sub(1);
+            if (stopping)
+                return;
+            idle = 0;
+        }
+    }
+};
+#endif
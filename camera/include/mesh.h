@@ -0,0 +1,325 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+#include "cpu_profiler.h"
+#include "gl_state.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+#include <initializer_list>
+
+// CPU side mesh: interleaved float vertices, stride floats each, plus a
+// triangle list index buffer
+struct MeshData
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    unsigned int stride = 0;
+
+    size_t vertexCount() const
+    {
+        return stride ? vertices.size() / stride : 0;
+    }
+};
+
+// merge bitwise identical vertices of a non-indexed triangle list and build
+// the index buffer that reproduces it
+// ------------------------------------------------------------------------
+inline MeshData weldVertices(const float *vertices, size_t vertexCount, unsigned int stride)
+{
+    struct VertexKey
+    {
+        const float *data;
+        unsigned int stride;
+        bool operator==(const VertexKey &other) const
+        {
+            return memcmp(data, other.data, stride * sizeof(float)) == 0;
+        }
+    };
+    struct VertexHash
+    {
+        size_t operator()(const VertexKey &key) const
+        {
+            // FNV-1a over the raw bytes
+            const unsigned char *bytes = (const unsigned char *)key.data;
+            size_t h = 14695981039346656037ULL;
+            for (size_t i = 0; i < key.stride * sizeof(float); i++)
+                h = (h ^ bytes[i]) * 1099511628211ULL;
+            return h;
+        }
+    };
+
+    MeshData mesh;
+    mesh.stride = stride;
+    mesh.indices.reserve(vertexCount);
+    std::unordered_map<VertexKey, unsigned int, VertexHash> unique;
+    unique.reserve(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        VertexKey key = { vertices + i * stride, stride };
+        auto inserted = unique.emplace(key, (unsigned int)mesh.vertexCount());
+        if (inserted.second)
+            mesh.vertices.insert(mesh.vertices.end(), key.data, key.data + stride);
+        mesh.indices.push_back(inserted.first->second);
+    }
+    return mesh;
+}
+
+// reorder triangles for the post-transform vertex cache with Tom Forsyth's
+// "linear-speed vertex cache optimisation": every vertex is scored by its
+// position in a simulated LRU cache and by how few triangles still use it,
+// and the best scoring triangle touching the cache is emitted next
+// ------------------------------------------------------------------------
+inline void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount)
+{
+    const int CACHE_SIZE = 32;
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    auto vertexScore = [CACHE_SIZE](int cachePosition, unsigned int remaining) {
+        if (remaining == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            // the last triangle's vertices get a fixed score so it isn't reused right away
+            if (cachePosition < 3)
+                score = 0.75f;
+            else
+                score = powf(1.0f - (float)(cachePosition - 3) / (float)(CACHE_SIZE - 3), 1.5f);
+        }
+        // boost vertices with few triangles left so they get finished off
+        return score + 2.0f * powf((float)remaining, -0.5f);
+    };
+
+    // vertex -> triangles adjacency as offsets into one array
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<unsigned int> cache, nextCache;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    size_t scanStart = 0;
+    long best = -1;
+    for (size_t t = 0; t < triangleCount; t++)
+        if (best < 0 || triangleScore[t] > triangleScore[best])
+            best = (long)t;
+
+    while (best >= 0)
+    {
+        emitted[best] = true;
+        const unsigned int *tri = &indices[best * 3];
+        output.insert(output.end(), tri, tri + 3);
+
+        // move the triangle's vertices to the front of the cache
+        nextCache.assign(tri, tri + 3);
+        for (unsigned int v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                nextCache.push_back(v);
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = tri[k];
+            remaining[v]--;
+            // drop the emitted triangle from the vertex's adjacency
+            for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v] + 1; a++)
+            {
+                if (adjacency[a] == (unsigned int)best)
+                {
+                    adjacency[a] = adjacency[offsets[v] + remaining[v]];
+                    break;
+                }
+            }
+        }
+
+        // rescore everything that was or is in the cache and pick the best
+        // triangle among their neighbours
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+            float newScore = vertexScore(cachePosition[v], remaining[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+            for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+                triangleScore[adjacency[a]] += delta;
+        }
+        for (size_t i = 0; i < nextCache.size() && i < (size_t)CACHE_SIZE; i++)
+        {
+            unsigned int v = nextCache[i];
+            for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+            {
+                unsigned int t = adjacency[a];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = (long)t;
+                }
+            }
+        }
+        if (nextCache.size() > (size_t)CACHE_SIZE)
+            nextCache.resize(CACHE_SIZE);
+        cache.swap(nextCache);
+
+        // nothing adjacent to the cache is left: continue with the next unused triangle
+        if (best < 0)
+        {
+            while (scanStart < triangleCount && emitted[scanStart])
+                scanStart++;
+            if (scanStart < triangleCount)
+                best = (long)scanStart;
+        }
+    }
+    indices.swap(output);
+}
+
+// renumber vertices in the order the index buffer first uses them, so the
+// vertex fetch walks the VBO mostly sequentially
+// ------------------------------------------------------------------------
+inline void optimizeVertexFetch(MeshData &mesh)
+{
+    const size_t vertexCount = mesh.vertexCount();
+    std::vector<unsigned int> remap(vertexCount, ~0u);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    unsigned int next = 0;
+    for (unsigned int &index : mesh.indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            remap[index] = next++;
+            const float *src = &mesh.vertices[(size_t)index * mesh.stride];
+            vertices.insert(vertices.end(), src, src + mesh.stride);
+        }
+        index = remap[index];
+    }
+    // vertices no triangle references are dropped
+    mesh.vertices.swap(vertices);
+}
+
+// average cache miss ratio: transformed vertices per triangle through a FIFO
+// cache of cacheSize entries. 3.0 is no reuse at all, 0.5 is the ideal for
+// a large regular grid.
+// ------------------------------------------------------------------------
+inline float averageCacheMissRatio(const std::vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = 16)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+    std::vector<unsigned int> insertedAt(vertexCount, 0);
+    unsigned int misses = 0;
+    for (unsigned int index : indices)
+    {
+        // insertedAt is the 1-based number of the miss that loaded the vertex
+        // (0: never); it is still in the FIFO if fewer than cacheSize misses
+        // have happened since
+        if (insertedAt[index] == 0 || misses - insertedAt[index] >= cacheSize)
+        {
+            misses++;
+            insertedAt[index] = misses;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+// weld, then order for the vertex cache and for vertex fetch
+// ------------------------------------------------------------------------
+inline MeshData buildIndexedMesh(const float *vertices, size_t vertexCount, unsigned int stride)
+{
+    PROFILE_ZONE("buildIndexedMesh");
+    MeshData mesh = weldVertices(vertices, vertexCount, stride);
+    optimizeVertexCache(mesh.indices, mesh.vertexCount());
+    optimizeVertexFetch(mesh);
+    return mesh;
+}
+
+// GPU side: a VAO with its own VBO/EBO, indices stored as 16-bit when they fit
+// ------------------------------------------------------------------------
+struct Mesh
+{
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    // attributeSizes lists the float count of each interleaved attribute,
+    // bound to locations 0, 1, ... in order
+    void upload(const MeshData &mesh, std::initializer_list<int> attributeSizes)
+    {
+        PROFILE_ZONE("Mesh::upload");
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        GLState.bindVertexArray(VAO);
+
+        GLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        indexCount = (GLsizei)mesh.indices.size();
+        if (mesh.vertexCount() <= 0xFFFF)
+        {
+            std::vector<uint16_t> shortIndices(mesh.indices.begin(), mesh.indices.end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+            indexType = GL_UNSIGNED_SHORT;
+        }
+        else
+        {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+            indexType = GL_UNSIGNED_INT;
+        }
+
+        GLuint location = 0;
+        size_t offset = 0;
+        for (int size : attributeSizes)
+        {
+            glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, mesh.stride * sizeof(float), (void*)(offset * sizeof(float)));
+            glEnableVertexAttribArray(location);
+            location++;
+            offset += size;
+        }
+        GLState.bindVertexArray(0);
+    }
+    void draw() const
+    {
+        GLState.bindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+    }
+    void drawInstanced(GLsizei instances) const
+    {
+        GLState.bindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, 0, instances);
+    }
+    void destroy()
+    {
+        GLState.vertexArrayDeleted(VAO);
+        GLState.bufferDeleted(VBO);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+    }
+};
+#endif
@@ -0,0 +1,200 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "cpu_profiler.h"
+#include "mesh.h"
+#include "tlsf_allocator.h"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <initializer_list>
+
+// where one mesh lives inside a MeshArena
+struct MeshRange
+{
+    GLuint firstIndex = 0;
+    GLuint indexCount = 0;
+    GLint baseVertex = 0;
+};
+
+// what MeshArena::add hands back: the range to draw, and the two
+// allocations to give back to remove()
+struct MeshHandle
+{
+    MeshRange range;
+    TlsfAllocation vertices, indices;
+
+    bool valid() const
+    {
+        return vertices.valid() && indices.valid();
+    }
+};
+
+// every static mesh of one vertex layout in a single vertex buffer and a
+// single index buffer, both allocated once at a fixed size (immutable
+// storage on GL 4.4) and handed out by a TLSF allocator in units of
+// vertices and indices, so meshes can come and go without a buffer object
+// each. Indices stay relative to their own mesh and are offset by
+// baseVertex at draw time.
+//
+// One VAO describes the layout for all of them. With vertex attrib binding
+// (GL 4.3) the format is set once with glVertexAttribFormat and the arena
+// attached with glBindVertexBuffer; without, glVertexAttribPointer does the
+// same for the one buffer. Either way switching meshes binds nothing.
+// ------------------------------------------------------------------------
+class MeshArena
+{
+public:
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+
+    // attributeSizes as for Mesh::upload. 16-bit indices limit each mesh,
+    // not the arena, to 65535 vertices
+    // ------------------------------------------------------------------------
+    void init(std::initializer_list<int> attributeSizes, uint32_t vertexCapacity, uint32_t indexCapacity,
+              GLenum indexType = GL_UNSIGNED_SHORT)
+    {
+        PROFILE_ZONE("MeshArena::init");
+        this->indexType = indexType;
+        stride = 0;
+        for (int size : attributeSizes)
+            stride += size;
+        vertexSpace.init(vertexCapacity);
+        indexSpace.init(indexCapacity);
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        GLState.bindVertexArray(VAO);
+        GLState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        allocateStorage(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * stride * sizeof(float));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        allocateStorage(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCapacity * indexSize());
+
+        GLuint location = 0;
+        size_t offset = 0;
+        for (int size : attributeSizes)
+        {
+            if (GLExt.vertexAttribBinding)
+            {
+                glVertexAttribFormat(location, size, GL_FLOAT, GL_FALSE, (GLuint)(offset * sizeof(float)));
+                glVertexAttribBinding(location, 0);
+            }
+            else
+            {
+                glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, stride * sizeof(float), (void*)(offset * sizeof(float)));
+            }
+            glEnableVertexAttribArray(location);
+            location++;
+            offset += size;
+        }
+        if (GLExt.vertexAttribBinding)
+            glBindVertexBuffer(0, VBO, 0, stride * sizeof(float));
+        GLState.bindVertexArray(0);
+    }
+    // copy a mesh in; an invalid handle if it doesn't fit or has another layout
+    // ------------------------------------------------------------------------
+    MeshHandle add(const MeshData &mesh)
+    {
+        PROFILE_ZONE("MeshArena::add");
+        MeshHandle handle;
+        if (mesh.stride != stride)
+        {
+            std::cout << "ERROR::MESH_ARENA::LAYOUT_MISMATCH" << std::endl;
+            return handle;
+        }
+        if (indexType == GL_UNSIGNED_SHORT && mesh.vertexCount() > 0xFFFF)
+        {
+            std::cout << "ERROR::MESH_ARENA::TOO_MANY_VERTICES_FOR_16_BIT_INDICES" << std::endl;
+            return handle;
+        }
+        handle.vertices = vertexSpace.allocate((uint32_t)mesh.vertexCount());
+        handle.indices = indexSpace.allocate((uint32_t)mesh.indices.size());
+        if (!handle.valid())
+        {
+            std::cout << "ERROR::MESH_ARENA::FULL" << std::endl;
+            remove(handle);
+            return handle;
+        }
+        handle.range.baseVertex = (GLint)handle.vertices.offset;
+        handle.range.firstIndex = handle.indices.offset;
+        handle.range.indexCount = (GLuint)mesh.indices.size();
+
+        // through the copy target, so the element binding of whatever VAO is bound stays put
+        GLState.bindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)handle.vertices.offset * stride * sizeof(float),
+                        mesh.vertices.size() * sizeof(float), mesh.vertices.data());
+        GLState.bindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        if (indexType == GL_UNSIGNED_SHORT)
+        {
+            std::vector<uint16_t> shortIndices(mesh.indices.begin(), mesh.indices.end());
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)handle.indices.offset * sizeof(uint16_t),
+                            shortIndices.size() * sizeof(uint16_t), shortIndices.data());
+        }
+        else
+        {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)handle.indices.offset * sizeof(unsigned int),
+                            mesh.indices.size() * sizeof(unsigned int), mesh.indices.data());
+        }
+        return handle;
+    }
+    // give a mesh's space back; draws already issued still see the old data
+    void remove(MeshHandle &handle)
+    {
+        vertexSpace.free(handle.vertices);
+        indexSpace.free(handle.indices);
+        handle = MeshHandle();
+    }
+
+    void draw(const MeshHandle &mesh) const
+    {
+        GLState.bindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, mesh.range.indexCount, indexType,
+                                 (void*)(mesh.range.firstIndex * indexSize()), mesh.range.baseVertex);
+    }
+    void drawInstanced(const MeshHandle &mesh, GLsizei instances) const
+    {
+        GLState.bindVertexArray(VAO);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.range.indexCount, indexType,
+                                          (void*)(mesh.range.firstIndex * indexSize()), instances, mesh.range.baseVertex);
+    }
+    size_t indexSize() const
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    }
+    const TlsfAllocator &vertexAllocator() const
+    {
+        return vertexSpace;
+    }
+    const TlsfAllocator &indexAllocator() const
+    {
+        return indexSpace;
+    }
+    void destroy()
+    {
+        GLState.vertexArrayDeleted(VAO);
+        GLState.bufferDeleted(VBO);
+        GLState.bufferDeleted(EBO);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+    }
+
+private:
+    TlsfAllocator vertexSpace, indexSpace;
+    unsigned int stride = 0;
+
+    static void allocateStorage(GLenum target, GLsizeiptr bytes)
+    {
+        if (GLExt.bufferStorage)
+            glBufferStorage(target, bytes, NULL, GL_DYNAMIC_STORAGE_BIT);
+        else
+            glBufferData(target, bytes, NULL, GL_STATIC_DRAW);
+    }
+};
+#endif
@@ -0,0 +1,143 @@
+#ifndef OBJECT_BUFFER_H
+#define OBJECT_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "uniform_blocks.h"
+#include "stream_buffer.h"
+#include "cpu_profiler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// everything a vertex shader needs to know about one object, fetched by
+// index instead of set as uniforms per draw. Mirrors ObjectData in
+// src/objects.vs; std430 packs it with no padding, and the buffer texture
+// fallback reads it as five RGBA32F texels.
+struct ObjectData
+{
+    glm::mat4 model;
+    glm::uvec4 material;    // x: material index, yzw free
+};
+static_assert(offsetof(ObjectData, model) == 0, "std430 offset of ObjectData.model");
+static_assert(offsetof(ObjectData, material) == 64, "std430 offset of ObjectData.material");
+static_assert(sizeof(ObjectData) == 80, "std430 size of ObjectData");
+
+// per-object data for a whole frame in one buffer, written with a single
+// upload. With shader storage buffers (GL 4.3) it is bound to the Objects
+// block; without, the same bytes are read through a buffer texture on
+// TEXTURE_UNIT. defines() tells the shader which of the two it gets.
+// ------------------------------------------------------------------------
+class ObjectBuffer
+{
+public:
+    static const GLuint TEXTURE_UNIT = 2;
+    GLuint ID = 0;
+    // buffer texture over ID, only without storage buffers
+    GLuint texture = 0;
+
+    void init(size_t capacity)
+    {
+        storage = GLExt.shaderStorage;
+        target = storage ? GL_SHADER_STORAGE_BUFFER : GL_TEXTURE_BUFFER;
+        glGenBuffers(1, &ID);
+        this->capacity = capacity > 0 ? capacity : 1;
+        GLState.bindBuffer(target, ID);
+        glBufferData(target, this->capacity * sizeof(ObjectData), NULL, GL_STREAM_DRAW);
+        // the texture refers to the buffer object, so it follows every reallocation
+        if (!storage)
+        {
+            glGenTextures(1, &texture);
+            GLState.bindTextureUnit(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, ID);
+        }
+    }
+    // shader defines matching how the data is bound, for Shader/ShaderBatch
+    static std::string defines()
+    {
+        std::string text;
+        if (GLExt.shaderStorage)
+            text += "#define OBJECT_SSBO\n";
+        // gl_BaseInstanceARB is only worth reading when draws can set it
+        if (GLExt.shaderDrawParameters && GLExt.baseInstance)
+            text += "#define DRAW_PARAMETERS\n";
+        return text;
+    }
+    // replace the contents with count objects; grows the buffer if needed,
+    // otherwise orphans it so the upload never waits on last frame's draws
+    // ------------------------------------------------------------------------
+    void update(const ObjectData *objects, size_t count)
+    {
+        PROFILE_ZONE("ObjectBuffer::update");
+        streamed = StreamSpan();
+        if (count > capacity)
+            capacity = count + count / 2;
+        GLState.bindBuffer(target, ID);
+        glBufferData(target, capacity * sizeof(ObjectData), NULL, GL_STREAM_DRAW);
+        glBufferSubData(target, 0, count * sizeof(ObjectData), objects);
+        numObjects = count;
+    }
+    void update(const std::vector<ObjectData> &objects)
+    {
+        update(objects.data(), objects.size());
+    }
+    // the same through this frame's region of a StreamBuffer, when the data
+    // is read as a storage buffer; the buffer texture can't view a range
+    // before GL 4.3 either, so the fallback keeps the plain upload
+    // ------------------------------------------------------------------------
+    void update(const ObjectData *objects, size_t count, StreamBuffer &stream)
+    {
+        PROFILE_ZONE("ObjectBuffer::update");
+        streamed = StreamSpan();
+        if (storage && count > 0)
+            streamed = stream.allocateStorage(count * sizeof(ObjectData));
+        if (!streamed)
+        {
+            update(objects, count);
+            return;
+        }
+        memcpy(streamed.data, objects, count * sizeof(ObjectData));
+        stream.flush();
+        streamID = stream.ID;
+        numObjects = count;
+    }
+    // attach to the binding the shaders read from
+    void bind() const
+    {
+        if (streamed)
+            GLState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, OBJECT_STORAGE_BINDING, streamID, streamed.offset, streamed.size);
+        else if (storage)
+            GLState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_STORAGE_BINDING, ID);
+        else
+            GLState.bindTextureUnit(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+    }
+    size_t objectCount() const
+    {
+        return numObjects;
+    }
+    void destroy()
+    {
+        GLState.bufferDeleted(ID);
+        glDeleteBuffers(1, &ID);
+        if (texture)
+        {
+            GLState.textureDeleted(texture);
+            glDeleteTextures(1, &texture);
+        }
+        ID = texture = 0;
+    }
+
+private:
+    bool storage = false;
+    GLenum target = GL_TEXTURE_BUFFER;
+    size_t capacity = 0, numObjects = 0;
+    // where this frame's objects went when they were streamed
+    StreamSpan streamed;
+    GLuint streamID = 0;
+};
+#endif
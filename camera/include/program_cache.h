@@ -0,0 +1,208 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+// persistent cache of linked program binaries (glGetProgramBinary output).
+// Entries are keyed by a hash of the shader sources, the defines and the
+// driver strings, so a driver update or an edited shader is simply a miss.
+// Anything that fails to validate or link is deleted and recompiled.
+class ProgramCache
+{
+public:
+    // where cache files are written, relative to the working directory
+    static inline std::string directory = "shader_cache";
+    static inline bool enabled = true;
+    // counters so startup behaviour can be checked from a run
+    static inline unsigned int hits = 0;
+    static inline unsigned int misses = 0;
+
+    // 64-bit FNV-1a, also used as the payload checksum
+    // ------------------------------------------------------------------------
+    static uint64_t hash(const void *data, size_t size, uint64_t h = 0xcbf29ce484222325ULL)
+    {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            h ^= bytes[i];
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+    static uint64_t hash(const std::string &s, uint64_t h)
+    {
+        // hash the terminator too so "ab"+"c" and "a"+"bc" differ
+        return hash(s.c_str(), s.size() + 1, h);
+    }
+
+    // key for one program; needs a current context for the driver strings
+    // ------------------------------------------------------------------------
+    static uint64_t key(const std::string &vertexCode, const std::string &fragmentCode, const std::string &defines)
+    {
+        uint64_t h = hash(vertexCode, 0xcbf29ce484222325ULL);
+        h = hash(fragmentCode, h);
+        h = hash(defines, h);
+        h = hash(glString(GL_VENDOR), h);
+        h = hash(glString(GL_RENDERER), h);
+        h = hash(glString(GL_VERSION), h);
+        h = hash(glString(GL_SHADING_LANGUAGE_VERSION), h);
+        return h;
+    }
+
+    static bool available()
+    {
+        if (!enabled || !GLExt.programBinary)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    // try to link program from a cached binary, true on success
+    // ------------------------------------------------------------------------
+    static bool load(GLuint program, uint64_t key)
+    {
+        if (!available())
+            return false;
+        std::string path = pathFor(key);
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            misses++;
+            return false;
+        }
+        Header header;
+        std::vector<char> binary;
+        bool valid = (bool)file.read((char *)&header, sizeof(header))
+            && memcmp(header.magic, MAGIC, 4) == 0
+            && header.version == VERSION
+            && header.key == key
+            && formatSupported(header.binaryFormat);
+        // the payload must fill the rest of the file exactly; checked before
+        // allocating so a corrupt length can't ask for gigabytes
+        std::error_code sizeError;
+        uintmax_t fileSize = std::filesystem::file_size(path, sizeError);
+        valid = valid && !sizeError && fileSize >= sizeof(header)
+            && header.length == fileSize - sizeof(header);
+        if (valid)
+        {
+            binary.resize(header.length);
+            valid = (bool)file.read(binary.data(), binary.size())
+                && hash(binary.data(), binary.size()) == header.checksum;
+        }
+        file.close();
+        if (valid)
+        {
+            glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+            GLint success = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            valid = success != 0;
+        }
+        if (!valid)
+        {
+            std::cout << "WARNING::PROGRAM_CACHE::STALE_ENTRY: " << path << std::endl;
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            misses++;
+            return false;
+        }
+        hits++;
+        return true;
+    }
+
+    // write a freshly linked program to the cache. The program should have been
+    // linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+    // ------------------------------------------------------------------------
+    static void store(GLuint program, uint64_t key)
+    {
+        if (!available())
+            return;
+        GLint success = 0, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!success || length <= 0)
+            return;
+
+        Header header;
+        memcpy(header.magic, MAGIC, 4);
+        header.version = VERSION;
+        header.key = key;
+        std::vector<char> binary(length);
+        GLsizei written = 0;
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return;
+        header.binaryFormat = format;
+        header.length = (uint32_t)written;
+        header.checksum = hash(binary.data(), (size_t)written);
+
+        // write to a temporary file and rename so a crash never leaves half an entry
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        std::string path = pathFor(key);
+        std::string tmpPath = path + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write((const char *)&header, sizeof(header));
+        file.write(binary.data(), written);
+        file.close();
+        if (!file)
+        {
+            std::cout << "WARNING::PROGRAM_CACHE::WRITE_FAILED: " << tmpPath << std::endl;
+            std::filesystem::remove(tmpPath, ec);
+            return;
+        }
+        std::filesystem::rename(tmpPath, path, ec);
+    }
+
+private:
+    static constexpr char MAGIC[4] = { 'G', 'L', 'P', 'B' };
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t length;
+        uint64_t checksum;
+    };
+
+    static std::string glString(GLenum name)
+    {
+        const char *s = (const char *)glGetString(name);
+        return s ? s : "";
+    }
+
+    static std::string pathFor(uint64_t key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+
+    static bool formatSupported(GLenum format)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+        std::vector<GLint> formats(count > 0 ? count : 1);
+        if (count > 0)
+            glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+        for (GLint i = 0; i < count; i++)
+            if ((GLenum)formats[i] == format)
+                return true;
+        return false;
+    }
+};
+#endif
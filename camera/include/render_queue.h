@@ -0,0 +1,154 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "cpu_profiler.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// builds the 64-bit sort keys of a RenderQueue. Sorting the keys ascending
+// gives the submission order, so the most expensive state to change sits in
+// the highest bits:
+//
+//   opaque       pass:4 | 0 | program:10 | textures:12 | vao:10 | depth:24 | 0:3
+//   translucent  pass:4 | 1 | ~depth:24 | program:10 | textures:12 | vao:10 | 0:3
+//
+// Within a pass opaque draws come first, grouped by state and front to back
+// inside each group so early depth testing rejects as much as it can.
+// Translucent draws come after, back to front, and only group by state when
+// at the same depth. Program and VAO are GL names and the texture set is
+// whatever the caller numbers its texture combinations; each is masked to its
+// field, so two that collide just share a group and cost a state change.
+// ------------------------------------------------------------------------
+class RenderKey
+{
+public:
+    static const int PASS_BITS = 4, PROGRAM_BITS = 10, TEXTURE_BITS = 12, VAO_BITS = 10, DEPTH_BITS = 24;
+    static const int PASS_SHIFT = 60;
+    static const int TRANSLUCENT_SHIFT = 59;
+    static const uint64_t TRANSLUCENT_BIT = 1ull << TRANSLUCENT_SHIFT;
+
+    static uint64_t field(uint64_t value, int bits, int shift)
+    {
+        return (value & ((1ull << bits) - 1)) << shift;
+    }
+    // depth as a fraction of the far plane, 0 at the camera
+    static uint32_t quantizeDepth(float depth)
+    {
+        if (!(depth > 0.0f))
+            return 0;
+        if (depth >= 1.0f)
+            return (1u << DEPTH_BITS) - 1;
+        return (uint32_t)(depth * (float)((1u << DEPTH_BITS) - 1));
+    }
+    static uint64_t opaque(unsigned int pass, unsigned int program, unsigned int textures, unsigned int vao, float depth)
+    {
+        return field(pass, PASS_BITS, PASS_SHIFT)
+             | field(program, PROGRAM_BITS, 49)
+             | field(textures, TEXTURE_BITS, 37)
+             | field(vao, VAO_BITS, 27)
+             | field(quantizeDepth(depth), DEPTH_BITS, 3);
+    }
+    static uint64_t translucent(unsigned int pass, unsigned int program, unsigned int textures, unsigned int vao, float depth)
+    {
+        return field(pass, PASS_BITS, PASS_SHIFT)
+             | TRANSLUCENT_BIT
+             | field(~quantizeDepth(depth), DEPTH_BITS, 35)
+             | field(program, PROGRAM_BITS, 25)
+             | field(textures, TEXTURE_BITS, 13)
+             | field(vao, VAO_BITS, 3);
+    }
+    static unsigned int pass(uint64_t key)
+    {
+        return (unsigned int)(key >> PASS_SHIFT);
+    }
+    static bool isTranslucent(uint64_t key)
+    {
+        return (key & TRANSLUCENT_BIT) != 0;
+    }
+};
+
+// one queued draw: its key and an index into whatever the caller keeps
+// about it (matrices, handles, counts)
+struct RenderItem
+{
+    uint64_t key;
+    uint32_t payload;
+};
+
+// the draws of a frame, filled in any order and sorted by key before
+// submission. sort() is an LSD radix sort over the key bytes: a single read
+// builds all eight histograms, then one stable scatter per byte, skipping
+// bytes every key has in common (the unused low bits, the pass when there
+// is only one). Stable, so draws with equal keys keep their queue order.
+// ------------------------------------------------------------------------
+class RenderQueue
+{
+public:
+    void clear()
+    {
+        queue.clear();
+    }
+    void reserve(size_t count)
+    {
+        queue.reserve(count);
+        scratch.reserve(count);
+    }
+    void push(uint64_t key, uint32_t payload)
+    {
+        queue.push_back({ key, payload });
+    }
+    // ------------------------------------------------------------------------
+    void sort()
+    {
+        PROFILE_ZONE("RenderQueue::sort");
+        size_t count = queue.size();
+        if (count < 2)
+            return;
+        uint32_t histograms[8][256];
+        memset(histograms, 0, sizeof(histograms));
+        for (const RenderItem &item : queue)
+            for (int byte = 0; byte < 8; byte++)
+                histograms[byte][(item.key >> (byte * 8)) & 0xFF]++;
+
+        scratch.resize(count);
+        RenderItem *source = queue.data();
+        RenderItem *destination = scratch.data();
+        for (int byte = 0; byte < 8; byte++)
+        {
+            uint32_t *histogram = histograms[byte];
+            // all in one bucket: this byte doesn't change the order
+            if (histogram[(source[0].key >> (byte * 8)) & 0xFF] == count)
+                continue;
+            uint32_t offset = 0;
+            for (int digit = 0; digit < 256; digit++)
+            {
+                uint32_t n = histogram[digit];
+                histogram[digit] = offset;
+                offset += n;
+            }
+            for (size_t i = 0; i < count; i++)
+                destination[histogram[(source[i].key >> (byte * 8)) & 0xFF]++] = source[i];
+            RenderItem *swap = source;
+            source = destination;
+            destination = swap;
+        }
+        // an odd number of scatters leaves the result in scratch
+        if (source != queue.data())
+            queue.swap(scratch);
+    }
+    const std::vector<RenderItem> &items() const
+    {
+        return queue;
+    }
+    size_t size() const
+    {
+        return queue.size();
+    }
+
+private:
+    std::vector<RenderItem> queue;
+    std::vector<RenderItem> scratch;
+};
+#endif
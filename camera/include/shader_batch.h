@@ -0,0 +1,69 @@
+#ifndef SHADER_BATCH_H
+#define SHADER_BATCH_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+#include "shader_m.h"
+
+#include <string>
+#include <vector>
+
+// compiles a set of programs together. submit() queues every compile and link
+// without querying any status, so with KHR_parallel_shader_compile the driver
+// builds them on its own threads while the caller does other startup work
+// (texture loading). poll() checks GL_COMPLETION_STATUS_KHR without blocking
+// and finish() gathers the results. Without the extension the same calls
+// work serially: poll() is always true and finish() does the waiting.
+class ShaderBatch
+{
+public:
+    // queue a program, returns its index in the finished list
+    // ------------------------------------------------------------------------
+    size_t add(const std::string &vertexPath, const std::string &fragmentPath, const std::string &defines = "")
+    {
+        requests.push_back({ vertexPath, fragmentPath, defines });
+        return requests.size() - 1;
+    }
+    // hand everything added so far to the driver
+    // ------------------------------------------------------------------------
+    void submit()
+    {
+        // let the driver pick how many compiler threads to use
+        if (GLExt.parallelShaderCompile && glMaxShaderCompilerThreadsKHR)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        for (size_t i = shaders.size(); i < requests.size(); i++)
+        {
+            shaders.emplace_back();
+            shaders.back().begin(requests[i].vertexPath.c_str(), requests[i].fragmentPath.c_str(), requests[i].defines);
+        }
+    }
+    // true when every submitted program can be finished without stalling
+    // ------------------------------------------------------------------------
+    bool poll() const
+    {
+        for (const Shader &shader : shaders)
+            if (!shader.ready())
+                return false;
+        return true;
+    }
+    // check errors, store binaries and reflect uniforms for every program
+    // ------------------------------------------------------------------------
+    std::vector<Shader> &finish()
+    {
+        submit();
+        for (Shader &shader : shaders)
+            shader.finish();
+        return shaders;
+    }
+
+private:
+    struct Request
+    {
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::string defines;
+    };
+    std::vector<Request> requests;
+    std::vector<Shader> shaders;
+};
+#endif
@@ -3,20 +3,97 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include "gl_ext.h"
+#include "program_cache.h"
+#include "cpu_profiler.h"
+#include "gl_state.h"
+#include "uniform_blocks.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+
+// typed uniform upload, one overload per GLSL type we hand out handles for
+// ------------------------------------------------------------------------
+inline void setUniform(GLint location, bool value)             { glUniform1i(location, (int)value); }
+inline void setUniform(GLint location, int value)              { glUniform1i(location, value); }
+inline void setUniform(GLint location, float value)            { glUniform1f(location, value); }
+inline void setUniform(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+inline void setUniform(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+inline void setUniform(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+inline void setUniform(GLint location, const glm::mat2 &mat)   { glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]); }
+inline void setUniform(GLint location, const glm::mat3 &mat)   { glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]); }
+inline void setUniform(GLint location, const glm::mat4 &mat)   { glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]); }
+
+// GL type enum(s) a C++ type may be bound to, used to validate handles
+inline bool uniformTypeMatches(GLenum type, bool)             { return type == GL_BOOL || type == GL_INT; }
+inline bool uniformTypeMatches(GLenum type, int)              { return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_1D
+                                                                    || type == GL_SAMPLER_2D || type == GL_SAMPLER_3D || type == GL_SAMPLER_CUBE
+                                                                    || type == GL_SAMPLER_2D_ARRAY || type == GL_SAMPLER_2D_SHADOW; }
+inline bool uniformTypeMatches(GLenum type, float)            { return type == GL_FLOAT; }
+inline bool uniformTypeMatches(GLenum type, const glm::vec2&) { return type == GL_FLOAT_VEC2; }
+inline bool uniformTypeMatches(GLenum type, const glm::vec3&) { return type == GL_FLOAT_VEC3; }
+inline bool uniformTypeMatches(GLenum type, const glm::vec4&) { return type == GL_FLOAT_VEC4; }
+inline bool uniformTypeMatches(GLenum type, const glm::mat2&) { return type == GL_FLOAT_MAT2; }
+inline bool uniformTypeMatches(GLenum type, const glm::mat3&) { return type == GL_FLOAT_MAT3; }
+inline bool uniformTypeMatches(GLenum type, const glm::mat4&) { return type == GL_FLOAT_MAT4; }
+
+// a resolved uniform location: setting it does no string work and no driver
+// lookup. Like the set* functions it writes to the currently bound program.
+// A handle for a uniform the linker optimized away has location -1, which GL
+// silently ignores.
+template <typename T>
+class Uniform
+{
+public:
+    GLint location = -1;
+
+    Uniform() = default;
+    explicit Uniform(GLint loc) : location(loc) {}
+
+    void set(const T &value) const
+    {
+        setUniform(location, value);
+    }
+    bool valid() const
+    {
+        return location != -1;
+    }
+};
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // one entry per active uniform, filled once at link time
+    struct UniformInfo
+    {
+        std::string name;
+        GLint location;
+        GLenum type;
+        GLint size;
+    };
+    // an empty shader, filled in later by begin()/finish()
+    Shader() : ID(0) {}
+    // constructor generates the shader on the fly, or relinks it from the
+    // program cache. defines are extra lines inserted after #version in both
+    // stages, e.g. "#define INSTANCED\n", and are part of the cache key.
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string &defines = "")
+    {
+        begin(vertexPath, fragmentPath, defines);
+        finish();
+    }
+    // first half of construction: reads the sources and either relinks from the
+    // cache or submits compile and link without asking for their status, so a
+    // driver with parallel compile can work on it in the background
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    void begin(const char* vertexPath, const char* fragmentPath, const std::string &defines = "")
     {
+        PROFILE_ZONE("Shader::begin");
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -45,97 +122,235 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
+        vertexCode = injectDefines(vertexCode, defines);
+        fragmentCode = injectDefines(fragmentCode, defines);
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
+        // 2. reuse a cached program binary if this exact source/driver pair was linked before
+        cacheKey = ProgramCache::key(vertexCode, fragmentCode, defines);
+        ID = glCreateProgram();
+        if (ProgramCache::load(ID, cacheKey))
+        {
+            bindShaderBlocks(ID);
+            reflectUniforms();
+            return;
+        }
+        // 3. compile shaders, errors are checked in finish()
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
         // shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        if (GLExt.programBinary)
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(ID);
+        pending = true;
+    }
+    // true once finish() would not block on the driver. Without parallel
+    // compile support there is nothing to poll, so it is always true.
+    // ------------------------------------------------------------------------
+    bool ready() const
+    {
+        if (!pending || !GLExt.parallelShaderCompile)
+            return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+    // second half of construction: report errors, store the binary and reflect
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        if (!pending)
+            return;
+        PROFILE_ZONE("Shader::finish");
+        pending = false;
+        checkCompileErrors(vertex, "VERTEX");
+        checkCompileErrors(fragment, "FRAGMENT");
         checkCompileErrors(ID, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
+        glDetachShader(ID, vertex);
+        glDetachShader(ID, fragment);
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-
+        vertex = fragment = 0;
+        ProgramCache::store(ID, cacheKey);
+        // 4. attach the shared uniform/storage blocks and build the uniform lookup table
+        bindShaderBlocks(ID);
+        reflectUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const
     { 
-        glUseProgram(ID); 
+        GLState.useProgram(ID); 
+    }
+    // look up an active uniform in the reflection table, NULL if it isn't active
+    // ------------------------------------------------------------------------
+    const UniformInfo *findUniform(const std::string &name) const
+    {
+        auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name,
+            [](const UniformInfo &info, const std::string &n) { return info.name < n; });
+        if (it == uniforms.end() || it->name != name)
+            return NULL;
+        return &*it;
+    }
+    GLint getLocation(const std::string &name) const
+    {
+        const UniformInfo *info = findUniform(name);
+        return info ? info->location : -1;
+    }
+    const std::vector<UniformInfo> &activeUniforms() const
+    {
+        return uniforms;
+    }
+    // resolve a typed handle once, then set it every frame without lookups
+    // ------------------------------------------------------------------------
+    template <typename T>
+    Uniform<T> uniform(const std::string &name) const
+    {
+        const UniformInfo *info = findUniform(name);
+        if (!info)
+        {
+            std::cout << "WARNING::SHADER::UNIFORM_NOT_ACTIVE: " << name << std::endl;
+            return Uniform<T>();
+        }
+        if (!uniformTypeMatches(info->type, T()))
+            std::cout << "WARNING::SHADER::UNIFORM_TYPE_MISMATCH: " << name << std::endl;
+        return Uniform<T>(info->location);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(getLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(getLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(getLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(getLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(getLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(getLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(getLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(getLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(getLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // sorted by name so lookups are a binary search over a flat array
+    std::vector<UniformInfo> uniforms;
+    // state carried from begin() to finish()
+    unsigned int vertex = 0, fragment = 0;
+    uint64_t cacheKey = 0;
+    bool pending = false;
+
+    // insert defines right after the #version line, which must stay first
+    // ------------------------------------------------------------------------
+    static std::string injectDefines(const std::string &source, const std::string &defines)
+    {
+        if (defines.empty())
+            return source;
+        std::string block = defines;
+        if (block.back() != '\n')
+            block += '\n';
+        size_t version = source.find("#version");
+        if (version == std::string::npos)
+            return block + source;
+        size_t lineEnd = source.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return source + "\n" + block;
+        return source.substr(0, lineEnd + 1) + block + source.substr(lineEnd + 1);
+    }
+
+    // enumerate every active uniform of the linked program
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        uniforms.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            UniformInfo info;
+            GLsizei length = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &info.size, &info.type, buffer.data());
+            info.name.assign(buffer.data(), length);
+            info.location = glGetUniformLocation(ID, info.name.c_str());
+            // members of uniform blocks have no location, they're set through their buffer
+            if (info.location == -1)
+                continue;
+            // arrays are reported as "name[0]": index them by their bare name,
+            // and every element by "name[i]" as glGetUniformLocation would
+            // (element locations needn't be consecutive, so ask for each)
+            if (info.name.size() > 3 && info.name.compare(info.name.size() - 3, 3, "[0]") == 0)
+            {
+                info.name.erase(info.name.size() - 3);
+                UniformInfo element = info;
+                element.size = 1;
+                for (GLint e = 0; e < info.size; e++)
+                {
+                    element.name = info.name + "[" + std::to_string(e) + "]";
+                    element.location = e == 0 ? info.location : glGetUniformLocation(ID, element.name.c_str());
+                    if (element.location != -1)
+                        uniforms.push_back(element);
+                }
+            }
+            uniforms.push_back(info);
+        }
+        std::sort(uniforms.begin(), uniforms.end(),
+            [](const UniformInfo &a, const UniformInfo &b) { return a.name < b.name; });
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,748 @@
+#ifndef SOFT_RASTERIZER_H
+#define SOFT_RASTERIZER_H
+
+#include <glm/glm.hpp>
+// stb_image.h has no guard around its implementation, so only pull it in
+// if the including file hasn't already (possibly with STB_IMAGE_IMPLEMENTATION)
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include <stb_image.h>
+#endif
+#include "cpu_profiler.h"
+#include "job_system.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#define SOFT_RASTER_SSE2 1
+#endif
+
+// an RGBA8 image sampled like a GL_NEAREST, GL_REPEAT texture. Texels are
+// stored as GL would hold the image after upload, so row 0 is v = 0.
+// ------------------------------------------------------------------------
+struct SoftTexture
+{
+    int width = 0, height = 0;
+    std::vector<uint32_t> texels;
+    // log2(width) when both sides are powers of two, else -1
+    int widthShift = -1;
+
+    // missing channels are filled in as the GL textures sample them: RGB gets
+    // an opaque alpha, grey and grey-alpha are spread like setGreySwizzle()
+    bool load(const std::string &path, bool flip = true)
+    {
+        stbi_set_flip_vertically_on_load_thread(flip);
+        int channels = 0;
+        unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        if (!pixels)
+        {
+            std::cout << "ERROR::SOFT_TEXTURE::FILE_NOT_LOADED: " << path << std::endl;
+            width = height = 0;
+            texels.clear();
+            return false;
+        }
+        texels.resize((size_t)width * height);
+        for (size_t i = 0; i < texels.size(); i++)
+        {
+            const unsigned char *p = pixels + i * channels;
+            uint32_t r = p[0];
+            uint32_t g = channels > 2 ? p[1] : r;
+            uint32_t b = channels > 2 ? p[2] : r;
+            uint32_t a = channels == 2 ? p[1] : channels > 3 ? p[3] : 255;
+            texels[i] = r | g << 8 | b << 16 | a << 24;
+        }
+        stbi_image_free(pixels);
+        widthShift = -1;
+        if ((width & (width - 1)) == 0 && (height & (height - 1)) == 0)
+            for (widthShift = 0; (1 << widthShift) < width; widthShift++)
+                ;
+        return true;
+    }
+    // texel (x, y) with both wrapped into the image
+    uint32_t fetch(int x, int y) const
+    {
+        return texels[(size_t)wrap(y, height) * width + wrap(x, width)];
+    }
+
+private:
+    static int wrap(int i, int size)
+    {
+        if ((size & (size - 1)) == 0)
+            return i & (size - 1);
+        i %= size;
+        return i < 0 ? i + size : i;
+    }
+};
+
+// what shader.vs and shader.fs compute, on the CPU: a triangle list (indexed,
+// or in vertex order when the mesh has no indices) with position at floats
+// 0-2 and texture coordinates at 3-4 of each vertex, transformed by
+// viewProjection * model * transform, textured with the mix of two nearest
+// sampled textures and depth tested with GL_LESS.
+//
+// A frame runs in two parallel passes. First the draws are split into
+// chunks, and each chunk transforms, clips and sets up its triangles and
+// bins them into the TILE x TILE screen tiles they touch. Then each tile is
+// cleared and rasterized on its own, walking the chunks' bins in draw order,
+// so no two jobs ever write the same pixel and the image doesn't depend on
+// the thread count. The tile kernel tests edges, depth and interpolates four
+// pixels at a time.
+//
+// The colour buffer is RGBA8 with the bottom row first, like glReadPixels
+// returns it, and rows stride() pixels apart.
+// ------------------------------------------------------------------------
+class SoftRasterizer
+{
+public:
+    static const int TILE = 64;
+
+    void resize(int width, int height)
+    {
+        this->width = width;
+        this->height = height;
+        rowStride = (width + 3) & ~3;
+        tilesX = (width + TILE - 1) / TILE;
+        tilesY = (height + TILE - 1) / TILE;
+        color.assign((size_t)rowStride * height, 0);
+        depth.assign((size_t)rowStride * height, 1.0f);
+    }
+
+    // per frame state, the camera block and shader uniforms of the GL path
+    // ------------------------------------------------------------------------
+    void setViewProjection(const glm::mat4 &viewProjection)
+    {
+        this->viewProjection = viewProjection;
+    }
+    void setTransform(const glm::mat4 &transform)
+    {
+        this->transform = transform;
+    }
+    // how much of the second texture shows, the last argument of mix()
+    void setMix(float amount)
+    {
+        mixAmount = amount;
+    }
+    void setClearColor(float r, float g, float b, float a)
+    {
+        clearColor[0] = r;
+        clearColor[1] = g;
+        clearColor[2] = b;
+        clearColor[3] = a;
+    }
+
+    // queue a draw for render(); the mesh and textures must live until then
+    void draw(const MeshData &mesh, const glm::mat4 &model, const SoftTexture *texture1, const SoftTexture *texture2)
+    {
+        draws.push_back({ &mesh, model, { texture1, texture2 } });
+    }
+    // clear, draw everything queued since the last call, and forget the draws
+    // ------------------------------------------------------------------------
+    void render(JobSystem &jobs)
+    {
+        PROFILE_ZONE("SoftRasterizer::render");
+        uint32_t clearTexel = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            float c = clearColor[i] < 0.0f ? 0.0f : clearColor[i] > 1.0f ? 1.0f : clearColor[i];
+            clearTexel |= (uint32_t)lroundf(c * 255.0f) << (8 * i);
+        }
+
+        // a few chunks per worker, so binning balances like any parallelFor
+        size_t chunkCount = jobs.threadCount() * 4;
+        if (chunkCount > draws.size())
+            chunkCount = draws.size() ? draws.size() : 1;
+        if (chunks.size() < chunkCount)
+            chunks.resize(chunkCount);
+        for (size_t c = 0; c < chunkCount; c++)
+        {
+            chunks[c].triangles.clear();
+            chunks[c].bins.resize((size_t)tilesX * tilesY);
+            for (std::vector<uint32_t> &bin : chunks[c].bins)
+                bin.clear();
+        }
+        jobs.parallelFor(0, chunkCount, 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++)
+                setupChunk(chunks[c], draws.size() * c / chunkCount, draws.size() * (c + 1) / chunkCount);
+        });
+
+        size_t tileCount = (size_t)tilesX * tilesY;
+        jobs.parallelFor(0, tileCount, 1, [&](size_t begin, size_t end) {
+            for (size_t tile = begin; tile < end; tile++)
+                renderTile((int)tile, chunkCount, clearTexel);
+        });
+
+        trianglesBinned = 0;
+        for (size_t c = 0; c < chunkCount; c++)
+            trianglesBinned += chunks[c].triangles.size();
+        draws.clear();
+    }
+
+    const uint32_t *colorBuffer() const
+    {
+        return color.data();
+    }
+    const float *depthBuffer() const
+    {
+        return depth.data();
+    }
+    int stride() const
+    {
+        return rowStride;
+    }
+    // triangles that survived clipping in the last render()
+    size_t triangleCount() const
+    {
+        return trianglesBinned;
+    }
+    static const char *kernelName()
+    {
+#ifdef SOFT_RASTER_SSE2
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    // clip space position and texture coordinates
+    struct ClipVertex
+    {
+        glm::vec4 position;
+        glm::vec2 texCoord;
+    };
+    // a + dx * x + dy * y at a pixel centre
+    struct Plane
+    {
+        float dx, dy, a;
+    };
+    // everything the tile kernel needs, in pixel coordinates. Edge i is
+    // positive inside; ties on it count as inside when bit i of ties is set.
+    struct Triangle
+    {
+        float edgeA[3], edgeB[3], edgeC[3];
+        // 1 / edgeA, 0 where that is 0
+        float inverseA[3];
+        Plane z, invW, uOverW, vOverW;
+        int minX, minY, maxX, maxY;
+        uint32_t ties;
+        const SoftTexture *textures[2];
+    };
+    struct Draw
+    {
+        const MeshData *mesh;
+        glm::mat4 model;
+        const SoftTexture *textures[2];
+    };
+    // a contiguous run of draws and what binning them produced; bins hold
+    // indices into triangles, in draw order, for each tile
+    struct Chunk
+    {
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<uint32_t>> bins;
+        std::vector<ClipVertex> vertices;
+    };
+
+    int width = 0, height = 0, rowStride = 0;
+    int tilesX = 0, tilesY = 0;
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::mat4 transform = glm::mat4(1.0f);
+    float mixAmount = 0.0f;
+    float clearColor[4] = {};
+    std::vector<Draw> draws;
+    std::vector<Chunk> chunks;
+    size_t trianglesBinned = 0;
+
+    // how far past the viewport x and y may go before a triangle is clipped
+    // instead of just rasterized, keeping edge functions well inside float range
+    static constexpr float GUARD_BAND = 2.0f;
+    // vertices snap to 1/16 pixel
+    static constexpr float SUBPIXEL = 16.0f;
+
+    // ------------------------------------------------------------------------
+    void setupChunk(Chunk &chunk, size_t first, size_t last)
+    {
+        PROFILE_ZONE("soft setup");
+        for (size_t d = first; d < last; d++)
+        {
+            const Draw &draw = draws[d];
+            const MeshData &mesh = *draw.mesh;
+            glm::mat4 matrix = viewProjection * draw.model * transform;
+            size_t vertexCount = mesh.vertexCount();
+            chunk.vertices.resize(vertexCount);
+            for (size_t v = 0; v < vertexCount; v++)
+            {
+                const float *in = &mesh.vertices[v * mesh.stride];
+                chunk.vertices[v].position = matrix * glm::vec4(in[0], in[1], in[2], 1.0f);
+                chunk.vertices[v].texCoord = glm::vec2(in[3], in[4]);
+            }
+            size_t cornerCount = mesh.indices.empty() ? vertexCount : mesh.indices.size();
+            for (size_t i = 0; i + 2 < cornerCount; i += 3)
+            {
+                ClipVertex corners[3];
+                for (int k = 0; k < 3; k++)
+                    corners[k] = chunk.vertices[mesh.indices.empty() ? i + k : mesh.indices[i + k]];
+                clipAndBin(chunk, corners, draw.textures);
+            }
+        }
+    }
+    // distance of v to clip plane p, positive inside: near, far, then the
+    // guard band left, right, bottom, top
+    static float clipDistance(const glm::vec4 &v, int p)
+    {
+        switch (p)
+        {
+            case 0:  return v.z + v.w;
+            case 1:  return v.w - v.z;
+            case 2:  return v.x + GUARD_BAND * v.w;
+            case 3:  return GUARD_BAND * v.w - v.x;
+            case 4:  return v.y + GUARD_BAND * v.w;
+            default: return GUARD_BAND * v.w - v.y;
+        }
+    }
+    // ------------------------------------------------------------------------
+    void clipAndBin(Chunk &chunk, const ClipVertex *corners, const SoftTexture *const *textures)
+    {
+        // all three outside one side of the viewport: nothing to draw
+        const glm::vec4 &a = corners[0].position, &b = corners[1].position, &c = corners[2].position;
+        if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w)
+            || (a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w))
+            return;
+        int outside = 0;
+        for (int p = 0; p < 6; p++)
+            for (int k = 0; k < 3; k++)
+                if (clipDistance(corners[k].position, p) < 0.0f)
+                    outside |= 1 << p;
+        if (!outside)
+        {
+            setupTriangle(chunk, corners[0], corners[1], corners[2], textures);
+            return;
+        }
+
+        // Sutherland-Hodgman against each plane something crosses, then a fan;
+        // attributes are linear in clip space, so plain lerps are exact
+        ClipVertex buffers[2][9];
+        int count = 3;
+        for (int k = 0; k < 3; k++)
+            buffers[0][k] = corners[k];
+        int current = 0;
+        for (int p = 0; p < 6 && count >= 3; p++)
+        {
+            if (!(outside & (1 << p)))
+                continue;
+            const ClipVertex *in = buffers[current];
+            ClipVertex *out = buffers[current ^ 1];
+            int outCount = 0;
+            for (int k = 0; k < count; k++)
+            {
+                const ClipVertex &from = in[k];
+                const ClipVertex &to = in[(k + 1) % count];
+                float dFrom = clipDistance(from.position, p);
+                float dTo = clipDistance(to.position, p);
+                if (dFrom >= 0.0f)
+                    out[outCount++] = from;
+                if ((dFrom >= 0.0f) != (dTo >= 0.0f))
+                {
+                    float t = dFrom / (dFrom - dTo);
+                    out[outCount].position = from.position + (to.position - from.position) * t;
+                    out[outCount].texCoord = from.texCoord + (to.texCoord - from.texCoord) * t;
+                    outCount++;
+                }
+            }
+            count = outCount;
+            current ^= 1;
+        }
+        for (int k = 1; k + 1 < count; k++)
+            setupTriangle(chunk, buffers[current][0], buffers[current][k], buffers[current][k + 1], textures);
+    }
+    // ------------------------------------------------------------------------
+    void setupTriangle(Chunk &chunk, const ClipVertex &c0, const ClipVertex &c1, const ClipVertex &c2,
+                       const SoftTexture *const *textures)
+    {
+        const ClipVertex *corners[3] = { &c0, &c1, &c2 };
+        float x[3], y[3], z[3], invW[3], u[3], v[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const glm::vec4 &p = corners[k]->position;
+            invW[k] = 1.0f / p.w;
+            // viewport transform, snapped to the subpixel grid
+            x[k] = roundf((p.x * invW[k] * 0.5f + 0.5f) * width * SUBPIXEL) / SUBPIXEL;
+            y[k] = roundf((p.y * invW[k] * 0.5f + 0.5f) * height * SUBPIXEL) / SUBPIXEL;
+            z[k] = p.z * invW[k] * 0.5f + 0.5f;
+            u[k] = corners[k]->texCoord.x * invW[k];
+            v[k] = corners[k]->texCoord.y * invW[k];
+        }
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (area == 0.0f)
+            return;
+        // no face culling, so both windings are drawn; flip clockwise ones
+        if (area < 0.0f)
+        {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            std::swap(invW[1], invW[2]);
+            std::swap(u[1], u[2]);
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        Triangle t;
+        t.ties = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            int j = (i + 1) % 3;
+            // exactly negated for the same edge of a neighbour wound the same way,
+            // so shared edges leave neither gaps nor double hits
+            t.edgeA[i] = y[i] - y[j];
+            t.edgeB[i] = x[j] - x[i];
+            t.edgeC[i] = x[i] * y[j] - x[j] * y[i];
+            t.inverseA[i] = t.edgeA[i] != 0.0f ? 1.0f / t.edgeA[i] : 0.0f;
+            // a pixel centre exactly on an edge belongs to one of its two triangles
+            if (t.edgeA[i] > 0.0f || (t.edgeA[i] == 0.0f && t.edgeB[i] > 0.0f))
+                t.ties |= 1u << i;
+        }
+        // vertex k's weight is the edge opposite it over the area
+        float invArea = 1.0f / area;
+        const float w0A = t.edgeA[1] * invArea, w1A = t.edgeA[2] * invArea, w2A = t.edgeA[0] * invArea;
+        const float w0B = t.edgeB[1] * invArea, w1B = t.edgeB[2] * invArea, w2B = t.edgeB[0] * invArea;
+        const float w0C = t.edgeC[1] * invArea, w1C = t.edgeC[2] * invArea, w2C = t.edgeC[0] * invArea;
+        auto plane = [&](const float *value) {
+            Plane p;
+            p.dx = w0A * value[0] + w1A * value[1] + w2A * value[2];
+            p.dy = w0B * value[0] + w1B * value[1] + w2B * value[2];
+            p.a = w0C * value[0] + w1C * value[1] + w2C * value[2];
+            return p;
+        };
+        t.z = plane(z);
+        t.invW = plane(invW);
+        t.uOverW = plane(u);
+        t.vOverW = plane(v);
+
+        // pixels whose centres may be inside
+        float minX = fminf(x[0], fminf(x[1], x[2])), maxX = fmaxf(x[0], fmaxf(x[1], x[2]));
+        float minY = fminf(y[0], fminf(y[1], y[2])), maxY = fmaxf(y[0], fmaxf(y[1], y[2]));
+        t.minX = (int)fmaxf(floorf(minX - 0.5f), 0.0f);
+        t.minY = (int)fmaxf(floorf(minY - 0.5f), 0.0f);
+        t.maxX = (int)fminf(ceilf(maxX - 0.5f), (float)(width - 1));
+        t.maxY = (int)fminf(ceilf(maxY - 0.5f), (float)(height - 1));
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return;
+        t.textures[0] = textures[0];
+        t.textures[1] = textures[1];
+
+        uint32_t index = (uint32_t)chunk.triangles.size();
+        chunk.triangles.push_back(t);
+        for (int ty = t.minY / TILE; ty <= t.maxY / TILE; ty++)
+        {
+            for (int tx = t.minX / TILE; tx <= t.maxX / TILE; tx++)
+            {
+                // skip tiles some edge leaves entirely outside, by testing the
+                // tile corner furthest along that edge's normal
+                float left = tx * TILE + 0.5f, bottom = ty * TILE + 0.5f;
+                bool covered = true;
+                for (int i = 0; i < 3 && covered; i++)
+                {
+                    float cx = t.edgeA[i] > 0.0f ? left + TILE - 1 : left;
+                    float cy = t.edgeB[i] > 0.0f ? bottom + TILE - 1 : bottom;
+                    covered = t.edgeA[i] * cx + (t.edgeB[i] * cy + t.edgeC[i]) >= 0.0f;
+                }
+                if (covered)
+                    chunk.bins[(size_t)ty * tilesX + tx].push_back(index);
+            }
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    void renderTile(int tile, size_t chunkCount, uint32_t clearTexel)
+    {
+        PROFILE_ZONE("soft tile");
+        int x0 = (tile % tilesX) * TILE, y0 = (tile / tilesX) * TILE;
+        int x1 = x0 + TILE < width ? x0 + TILE : width;
+        int y1 = y0 + TILE < height ? y0 + TILE : height;
+        // which triangle each pixel of the tile ends up showing. Shading waits
+        // until the depth test has settled, so every pixel is shaded once no
+        // matter how many triangles cover it.
+        thread_local std::vector<const Triangle*> winners;
+        winners.assign(TILE * TILE, nullptr);
+        // whole groups of four, into the padding at the right edge
+        int x1Padded = (x1 + 3) & ~3;
+        for (int y = y0; y < y1; y++)
+            std::fill(depth.begin() + (size_t)y * rowStride + x0, depth.begin() + (size_t)y * rowStride + x1Padded, 1.0f);
+        for (size_t c = 0; c < chunkCount; c++)
+        {
+            const Chunk &chunk = chunks[c];
+            for (uint32_t index : chunk.bins[tile])
+            {
+                const Triangle &t = chunk.triangles[index];
+                int minX = t.minX > x0 ? t.minX : x0;
+                int maxX = t.maxX < x1 - 1 ? t.maxX : x1 - 1;
+                int minY = t.minY > y0 ? t.minY : y0;
+                int maxY = t.maxY < y1 - 1 ? t.maxY : y1 - 1;
+#ifdef SOFT_RASTER_SSE2
+                rasterizeSSE2(t, minX, maxX, minY, maxY, x0, y0, winners.data());
+#else
+                rasterizeScalar(t, minX, maxX, minY, maxY, x0, y0, winners.data());
+#endif
+            }
+        }
+        shadeTile(x0, y0, x1Padded, y1, winners.data(), clearTexel);
+    }
+
+    // the columns first..last of the row whose edge functions are rows[] that
+    // may be inside, generously: the exact test per pixel still decides.
+    // False when none can be.
+    static bool rowSpan(const Triangle &t, const float *rows, int &first, int &last)
+    {
+        float left = (float)first, right = (float)last;
+        for (int i = 0; i < 3; i++)
+        {
+            float a = t.edgeA[i];
+            if (a == 0.0f)
+            {
+                if (rows[i] < 0.0f)
+                    return false;
+                continue;
+            }
+            // where the edge crosses the row, widened by what rounding in the
+            // kernels' evaluation of the edge could be worth
+            float crossing = -rows[i] * t.inverseA[i];
+            float slack = 1.0f + (right + 1.0f + fabsf(crossing)) * (1.0f / (1 << 20));
+            crossing -= 0.5f;
+            if (a > 0.0f && crossing - slack > left)
+                left = crossing - slack;
+            else if (a < 0.0f && crossing + slack < right)
+                right = crossing + slack;
+        }
+        if (left > right)
+            return false;
+        first = (int)floorf(left);
+        last = (int)ceilf(right);
+        return true;
+    }
+
+    // depth test the triangle over rows minY..maxY, columns minX..maxX of the
+    // tile at x0, y0, and make it the winner wherever it passes
+    // ------------------------------------------------------------------------
+    void rasterizeScalar(const Triangle &t, int minX, int maxX, int minY, int maxY, int x0, int y0,
+                         const Triangle **winners)
+    {
+        for (int y = minY; y <= maxY; y++)
+        {
+            float py = y + 0.5f;
+            float rows[3];
+            for (int i = 0; i < 3; i++)
+                rows[i] = t.edgeB[i] * py + t.edgeC[i];
+            int first = minX, last = maxX;
+            if (!rowSpan(t, rows, first, last))
+                continue;
+            float zRow = t.z.dy * py + t.z.a;
+            float *depthRow = &depth[(size_t)y * rowStride];
+            const Triangle **winnerRow = winners + (size_t)(y - y0) * TILE;
+            for (int x = first; x <= last; x++)
+            {
+                float px = x + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 3; i++)
+                {
+                    float e = t.edgeA[i] * px + rows[i];
+                    inside = inside && (e > 0.0f || (e == 0.0f && (t.ties & (1u << i))));
+                }
+                float z = t.z.dx * px + zRow;
+                if (inside && z < depthRow[x])
+                {
+                    depthRow[x] = z;
+                    winnerRow[x - x0] = &t;
+                }
+            }
+        }
+    }
+
+    // the fragment shader for one covered pixel
+    uint32_t shade(const Triangle &t, float u, float v) const
+    {
+        if (mixAmount <= 0.0f)
+            return sample(t.textures[0], u, v);
+        if (mixAmount >= 1.0f)
+            return sample(t.textures[1], u, v);
+        return mix(sample(t.textures[0], u, v), sample(t.textures[1], u, v));
+    }
+    uint32_t mix(uint32_t first, uint32_t second) const
+    {
+        uint32_t weight = (uint32_t)(mixAmount * 256.0f + 0.5f);
+        uint32_t mixed = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            uint32_t a = (first >> shift) & 0xFF, b = (second >> shift) & 0xFF;
+            mixed |= ((a * (256 - weight) + b * weight + 128) >> 8) << shift;
+        }
+        return mixed;
+    }
+    static uint32_t sample(const SoftTexture *texture, float u, float v)
+    {
+        if (!texture || texture->texels.empty())
+            return 0xFF808080u;
+        return texture->fetch((int)floorf(u * texture->width), (int)floorf(v * texture->height));
+    }
+    // perspective correct texture coordinates of t at a pixel centre
+    uint32_t shadePixel(const Triangle &t, float px, float py) const
+    {
+        float w = 1.0f / (t.invW.dx * px + (t.invW.dy * py + t.invW.a));
+        return shade(t, (t.uOverW.dx * px + (t.uOverW.dy * py + t.uOverW.a)) * w,
+                     (t.vOverW.dx * px + (t.vOverW.dy * py + t.vOverW.a)) * w);
+    }
+
+    // colour columns x0..x1 (a multiple of four past x0) of rows y0..y1 from
+    // the winners, or with the clear colour where nothing was drawn
+    // ------------------------------------------------------------------------
+    void shadeTile(int x0, int y0, int x1, int y1, const Triangle *const *winners, uint32_t clearTexel)
+    {
+        PROFILE_ZONE("soft shade");
+#ifdef SOFT_RASTER_SSE2
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        alignas(16) uint32_t first[4], second[4];
+#endif
+        for (int y = y0; y < y1; y++)
+        {
+            float py = y + 0.5f;
+            const Triangle *const *winnerRow = winners + (size_t)(y - y0) * TILE;
+            uint32_t *colorRow = &color[(size_t)y * rowStride];
+            for (int x = x0; x < x1; x += 4)
+            {
+                const Triangle *const *group = winnerRow + (x - x0);
+#ifdef SOFT_RASTER_SSE2
+                // four pixels of one triangle, the usual case, interpolate together
+                // with the same operations shadePixel uses
+                const Triangle *t = group[0];
+                if (t && group[1] == t && group[2] == t && group[3] == t)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+                    __m128 w = _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->invW.dx), px),
+                                                          _mm_set1_ps(t->invW.dy * py + t->invW.a)));
+                    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->uOverW.dx), px),
+                                                     _mm_set1_ps(t->uOverW.dy * py + t->uOverW.a)), w);
+                    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->vOverW.dx), px),
+                                                     _mm_set1_ps(t->vOverW.dy * py + t->vOverW.a)), w);
+                    if (mixAmount <= 0.0f || mixAmount >= 1.0f)
+                    {
+                        sampleSSE2(t->textures[mixAmount <= 0.0f ? 0 : 1], u, v, colorRow + x);
+                    }
+                    else
+                    {
+                        sampleSSE2(t->textures[0], u, v, first);
+                        sampleSSE2(t->textures[1], u, v, second);
+                        for (int lane = 0; lane < 4; lane++)
+                            colorRow[x + lane] = mix(first[lane], second[lane]);
+                    }
+                    continue;
+                }
+#endif
+                for (int lane = 0; lane < 4; lane++)
+                    colorRow[x + lane] = group[lane] ? shadePixel(*group[lane], x + lane + 0.5f, py) : clearTexel;
+            }
+        }
+    }
+
+#ifdef SOFT_RASTER_SSE2
+    // sample() for four pixels into texels (16 byte aligned); floor, wrap and
+    // addressing go four at a time when the sides are powers of two
+    static void sampleSSE2(const SoftTexture *texture, __m128 u, __m128 v, uint32_t *texels)
+    {
+        if (!texture || texture->texels.empty() || texture->widthShift < 0)
+        {
+            alignas(16) float us[4], vs[4];
+            _mm_store_ps(us, u);
+            _mm_store_ps(vs, v);
+            for (int lane = 0; lane < 4; lane++)
+                texels[lane] = sample(texture, us[lane], vs[lane]);
+            return;
+        }
+        __m128 fu = _mm_mul_ps(u, _mm_set1_ps((float)texture->width));
+        __m128 fv = _mm_mul_ps(v, _mm_set1_ps((float)texture->height));
+        // truncation rounds up below zero, take one off there
+        __m128i iu = _mm_cvttps_epi32(fu), iv = _mm_cvttps_epi32(fv);
+        iu = _mm_add_epi32(iu, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(iu), fu)));
+        iv = _mm_add_epi32(iv, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(iv), fv)));
+        iu = _mm_and_si128(iu, _mm_set1_epi32(texture->width - 1));
+        iv = _mm_and_si128(iv, _mm_set1_epi32(texture->height - 1));
+        alignas(16) uint32_t index[4];
+        _mm_store_si128((__m128i *)index, _mm_or_si128(_mm_sll_epi32(iv, _mm_cvtsi32_si128(texture->widthShift)), iu));
+        const uint32_t *source = texture->texels.data();
+        _mm_store_si128((__m128i *)texels, _mm_setr_epi32((int)source[index[0]], (int)source[index[1]],
+                                                          (int)source[index[2]], (int)source[index[3]]));
+    }
+    // lanes whose edge value e counts as inside
+    static __m128 insideSSE2(__m128 e, __m128 tie)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        return _mm_or_ps(_mm_cmpgt_ps(e, zero), _mm_and_ps(_mm_cmpeq_ps(e, zero), tie));
+    }
+    // rasterizeScalar four pixels per step, with the same operations in the
+    // same order so both pick the same winners
+    // ------------------------------------------------------------------------
+    void rasterizeSSE2(const Triangle &t, int minX, int maxX, int minY, int maxY, int x0, int y0,
+                       const Triangle **winners)
+    {
+        const __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128i laneIndex = _mm_setr_epi32(0, 1, 2, 3);
+        const __m128 edgeA0 = _mm_set1_ps(t.edgeA[0]), edgeA1 = _mm_set1_ps(t.edgeA[1]), edgeA2 = _mm_set1_ps(t.edgeA[2]);
+        const __m128 tie0 = _mm_castsi128_ps(_mm_set1_epi32(t.ties & 1u ? -1 : 0));
+        const __m128 tie1 = _mm_castsi128_ps(_mm_set1_epi32(t.ties & 2u ? -1 : 0));
+        const __m128 tie2 = _mm_castsi128_ps(_mm_set1_epi32(t.ties & 4u ? -1 : 0));
+        const __m128 zDx = _mm_set1_ps(t.z.dx);
+        const __m128i self = _mm_set1_epi64x((long long)(uintptr_t)&t);
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            float py = y + 0.5f;
+            float rowValues[3];
+            for (int i = 0; i < 3; i++)
+                rowValues[i] = t.edgeB[i] * py + t.edgeC[i];
+            int first = minX, last = maxX;
+            if (!rowSpan(t, rowValues, first, last))
+                continue;
+            __m128 row0 = _mm_set1_ps(rowValues[0]), row1 = _mm_set1_ps(rowValues[1]), row2 = _mm_set1_ps(rowValues[2]);
+            __m128 zRow = _mm_set1_ps(t.z.dy * py + t.z.a);
+            // lanes past last in the final group are masked off
+            __m128i columnEnd = _mm_set1_epi32(last + 1);
+            float *depthRow = &depth[(size_t)y * rowStride];
+            const Triangle **winnerRow = winners + (size_t)(y - y0) * TILE;
+            // tiles start at a multiple of four, so groups never straddle two
+            for (int x = first & ~3; x <= last; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+                __m128 mask = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_add_epi32(_mm_set1_epi32(x), laneIndex), columnEnd));
+                mask = _mm_and_ps(mask, insideSSE2(_mm_add_ps(_mm_mul_ps(edgeA0, px), row0), tie0));
+                mask = _mm_and_ps(mask, insideSSE2(_mm_add_ps(_mm_mul_ps(edgeA1, px), row1), tie1));
+                mask = _mm_and_ps(mask, insideSSE2(_mm_add_ps(_mm_mul_ps(edgeA2, px), row2), tie2));
+                if (!_mm_movemask_ps(mask))
+                    continue;
+                // most covered pixels fail the depth test and which ones is hard
+                // to predict, so the rest is written without branches
+                __m128 z = _mm_add_ps(_mm_mul_ps(zDx, px), zRow);
+                __m128 stored = _mm_load_ps(depthRow + x);
+                mask = _mm_and_ps(mask, _mm_cmplt_ps(z, stored));
+                _mm_store_ps(depthRow + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, stored)));
+                // the winner pointers, two to a register, each lane's mask widened to 64 bits
+                __m128i *winnerGroup = (__m128i *)(winnerRow + (x - x0));
+                __m128i laneMask = _mm_castps_si128(mask);
+                __m128i low = _mm_unpacklo_epi32(laneMask, laneMask);
+                __m128i high = _mm_unpackhi_epi32(laneMask, laneMask);
+                __m128i oldLow = _mm_load_si128(winnerGroup);
+                __m128i oldHigh = _mm_load_si128(winnerGroup + 1);
+                _mm_store_si128(winnerGroup, _mm_or_si128(_mm_and_si128(low, self), _mm_andnot_si128(low, oldLow)));
+                _mm_store_si128(winnerGroup + 1, _mm_or_si128(_mm_and_si128(high, self), _mm_andnot_si128(high, oldHigh)));
+            }
+        }
+    }
+#endif
+};
+#endif
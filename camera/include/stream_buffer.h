@@ -0,0 +1,235 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "cpu_profiler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+// a write-only slice of a StreamBuffer: fill data, then point GL at
+// offset/size of StreamBuffer::ID. Empty when the frame's region was full.
+struct StreamSpan
+{
+    void *data = nullptr;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+
+    explicit operator bool() const
+    {
+        return data != nullptr;
+    }
+};
+
+// one buffer for everything rewritten every frame (dynamic vertices,
+// indices, uniforms, object data), split into FRAMES regions used in turn.
+// Allocation just bumps an offset through the current region. The region
+// gets a fence at endFrame() and beginFrame() waits on it before handing the
+// same region out again, FRAMES - 1 frames later, so the CPU never writes
+// what the GPU may still read and nothing ever needs orphaning.
+//
+// With buffer storage (GL 4.4) the whole buffer is mapped once, persistent
+// and coherent, and spans are plain pointers into it. Without, the region
+// is mapped unsynchronized on the first allocation and unmapped by flush();
+// the fences keep that just as safe. Call flush() after writing and before
+// any draw reads the data, it costs nothing when mapped persistently.
+// ------------------------------------------------------------------------
+class StreamBuffer
+{
+public:
+    static const int FRAMES = 3;
+    GLuint ID = 0;
+    // bytes handed out since init, for benchmark counters
+    uint64_t bytesAllocated = 0;
+
+    void init(size_t bytesPerFrame)
+    {
+        persistentMap = GLExt.bufferStorage;
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment = alignment > 0 ? (size_t)alignment : 256;
+        if (GLExt.shaderStorage)
+        {
+            alignment = 0;
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            storageAlignment = alignment > 0 ? (size_t)alignment : 256;
+        }
+        // regions start at a multiple of every alignment handed out
+        size_t regionAlignment = 256;
+        if (uniformAlignment > regionAlignment)
+            regionAlignment = uniformAlignment;
+        if (storageAlignment > regionAlignment)
+            regionAlignment = storageAlignment;
+        regionSize = (bytesPerFrame + regionAlignment - 1) / regionAlignment * regionAlignment;
+        glGenBuffers(1, &ID);
+        GLState.bindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        GLsizeiptr size = (GLsizeiptr)(regionSize * FRAMES);
+        if (persistentMap)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+            base = (uint8_t *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+            if (!base)
+            {
+                std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+                persistentMap = false;
+                // storage is immutable, start over with a mutable buffer
+                GLState.bufferDeleted(ID);
+                glDeleteBuffers(1, &ID);
+                glGenBuffers(1, &ID);
+                GLState.bindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            }
+        }
+        if (!persistentMap)
+            glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+        region = 0;
+        head = 0;
+    }
+    // move to the next region, waiting until the GPU is done with it
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        PROFILE_ZONE("StreamBuffer::beginFrame");
+        region = (region + 1) % FRAMES;
+        head = 0;
+        GLsync &fence = fences[region];
+        if (!fence)
+            return;
+        // the first wait flushes so the fence is sure to signal; anything but
+        // GL_ALREADY_SIGNALED means this frame waited, however long it took
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        bool waited = false;
+        while (true)
+        {
+            GLenum status = glClientWaitSync(fence, flags, 1000000);
+            if (status == GL_WAIT_FAILED)
+            {
+                std::cout << "ERROR::STREAM_BUFFER::WAIT_FAILED" << std::endl;
+                break;
+            }
+            if (status != GL_ALREADY_SIGNALED)
+                waited = true;
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+                break;
+            flags = 0;
+        }
+        if (waited)
+            stalls++;
+        glDeleteSync(fence);
+        fence = 0;
+    }
+    // bytes at a multiple of alignment (a power of two) in this frame's region
+    // ------------------------------------------------------------------------
+    StreamSpan allocate(size_t bytes, size_t alignment = 16)
+    {
+        StreamSpan span;
+        size_t offset = (head + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes > regionSize)
+        {
+            if (!reportedFull)
+                std::cout << "ERROR::STREAM_BUFFER::FRAME_FULL " << bytes << " bytes" << std::endl;
+            reportedFull = true;
+            return span;
+        }
+        head = offset + bytes;
+        size_t absolute = region * regionSize + offset;
+        if (persistentMap)
+        {
+            span.data = base + absolute;
+        }
+        else
+        {
+            if (!mapped)
+                mapRemaining(absolute);
+            if (!mapped)
+                return StreamSpan();
+            span.data = mapped + (absolute - mappedOffset);
+        }
+        span.offset = (GLintptr)absolute;
+        span.size = (GLsizeiptr)bytes;
+        bytesAllocated += bytes;
+        return span;
+    }
+    StreamSpan allocateUniform(size_t bytes)
+    {
+        return allocate(bytes, uniformAlignment);
+    }
+    StreamSpan allocateStorage(size_t bytes)
+    {
+        return allocate(bytes, storageAlignment);
+    }
+    // make everything written so far visible to GL
+    void flush()
+    {
+        if (!mapped)
+            return;
+        size_t end = region * regionSize + head;
+        GLState.bindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)(end - mappedOffset));
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        mapped = nullptr;
+    }
+    // after the last draw that reads this frame's region
+    void endFrame()
+    {
+        flush();
+        if (fences[region])
+            glDeleteSync(fences[region]);
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    bool persistent() const
+    {
+        return persistentMap;
+    }
+    // times beginFrame() had to wait for the GPU
+    unsigned long stallCount() const
+    {
+        return stalls;
+    }
+    void destroy()
+    {
+        flush();
+        for (GLsync &fence : fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        GLState.bindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        if (persistentMap)
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        GLState.bufferDeleted(ID);
+        glDeleteBuffers(1, &ID);
+        ID = 0;
+        base = nullptr;
+    }
+
+private:
+    bool persistentMap = false;
+    uint8_t *base = nullptr;
+    // the unsynchronized mapping without buffer storage, from mappedOffset
+    // to the end of the region
+    uint8_t *mapped = nullptr;
+    size_t mappedOffset = 0;
+    size_t regionSize = 0;
+    size_t region = 0, head = 0;
+    size_t uniformAlignment = 256, storageAlignment = 256;
+    GLsync fences[FRAMES] = {};
+    unsigned long stalls = 0;
+    bool reportedFull = false;
+
+    void mapRemaining(size_t absolute)
+    {
+        size_t end = (region + 1) * regionSize;
+        GLState.bindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+        mapped = (uint8_t *)glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)absolute, (GLsizeiptr)(end - absolute), flags);
+        mappedOffset = absolute;
+        if (!mapped)
+            std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+    }
+};
+#endif
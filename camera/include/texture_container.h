@@ -0,0 +1,317 @@
+#ifndef TEXTURE_CONTAINER_H
+#define TEXTURE_CONTAINER_H
+
+#include <glad/glad.h>
+#include "gl_ext.h"
+#include "cpu_profiler.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// baked texture container (.btex), written offline by tools/bake_textures.cpp.
+// Like KTX2 it stores the final GL internal format and every mip level, so
+// loading is an mmap and one glTexSubImage2D per level straight out of the
+// mapping: no decode, no glGenerateMipmap and no staging copy of our own.
+//
+// layout: BakedTextureHeader, levelCount BakedLevel entries, then the level
+// data, each level starting on a 16 byte boundary with tightly packed rows.
+struct BakedTextureHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t internalFormat;    // sized format, e.g. GL_RGBA8
+    uint32_t format;            // pixel transfer format, e.g. GL_RGBA
+    uint32_t type;              // GL_UNSIGNED_BYTE
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t bytesPerPixel;
+    uint32_t flags;             // BAKED_TEXTURE_* bits
+    uint32_t reserved;          // 0; pads the header so the level table is 8-byte aligned
+};
+
+struct BakedLevel
+{
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+// the level table is read in place from the mapping, which is page aligned
+static_assert(sizeof(BakedTextureHeader) % alignof(BakedLevel) == 0, "BakedLevel table would be misaligned");
+
+static const char BAKED_TEXTURE_MAGIC[8] = { 'B', 'T', 'E', 'X', '\r', '\n', 0x1a, '\n' };
+static const uint32_t BAKED_TEXTURE_VERSION = 3;
+// rows were flipped on bake so row 0 is the bottom of the image (v = 0)
+static const uint32_t BAKED_TEXTURE_FLIPPED = 1;
+
+// read-only mapping of a whole file, unmapped on destruction
+// ------------------------------------------------------------------------
+class MappedFile
+{
+public:
+    MappedFile() {}
+    explicit MappedFile(const char *path)
+    {
+        open(path);
+    }
+    ~MappedFile()
+    {
+        close();
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char *path)
+    {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                bytes = (const unsigned char *)mapping;
+                length = (size_t)st.st_size;
+            }
+        }
+        ::close(fd);
+        return bytes != NULL;
+    }
+    void close()
+    {
+        if (bytes)
+            munmap((void *)bytes, length);
+        bytes = NULL;
+        length = 0;
+    }
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char *bytes = NULL;
+    size_t length = 0;
+};
+
+// a validated view into a mapped container; level pointers point into the mapping
+// ------------------------------------------------------------------------
+struct BakedTextureView
+{
+    const BakedTextureHeader *header = NULL;
+    const BakedLevel *levels = NULL;
+
+    const unsigned char *levelData(const MappedFile &file, uint32_t level) const
+    {
+        return file.data() + levels[level].offset;
+    }
+};
+
+// everything GL will be told is checked against the file: the formats are
+// ones the baker writes, every level is the halved size of the one before
+// (so the chain fits the storage allocated for it) and lies inside the mapping
+inline bool parseBakedTexture(const MappedFile &file, BakedTextureView &view)
+{
+    static const GLenum formats[5] = { 0, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const GLenum internalFormats[5] = { 0, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    if (file.size() < sizeof(BakedTextureHeader))
+        return false;
+    const BakedTextureHeader *header = (const BakedTextureHeader *)file.data();
+    if (memcmp(header->magic, BAKED_TEXTURE_MAGIC, 8) != 0 || header->version != BAKED_TEXTURE_VERSION)
+        return false;
+    if (header->bytesPerPixel < 1 || header->bytesPerPixel > 4 || header->type != GL_UNSIGNED_BYTE
+        || header->format != formats[header->bytesPerPixel] || header->internalFormat != internalFormats[header->bytesPerPixel])
+        return false;
+    if (header->width == 0 || header->height == 0 || header->levelCount == 0 || header->levelCount > 32)
+        return false;
+    uint64_t tableEnd = sizeof(BakedTextureHeader) + (uint64_t)header->levelCount * sizeof(BakedLevel);
+    if (file.size() < tableEnd)
+        return false;
+    const BakedLevel *levels = (const BakedLevel *)(file.data() + sizeof(BakedTextureHeader));
+    uint32_t width = header->width, height = header->height;
+    for (uint32_t i = 0; i < header->levelCount; i++)
+    {
+        if (levels[i].width != width || levels[i].height != height)
+            return false;
+        uint64_t expected = (uint64_t)width * height * header->bytesPerPixel;
+        // written as two comparisons so a huge offset can't wrap around
+        if (levels[i].size != expected || levels[i].offset < tableEnd
+            || levels[i].offset > file.size() || levels[i].size > file.size() - levels[i].offset)
+            return false;
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    view.header = header;
+    view.levels = levels;
+    return true;
+}
+
+// grey and grey-alpha images are stored as GL_RED / GL_RG; without a
+// swizzle on the bound texture they would sample as (r, 0, 0, 1) and come
+// out red
+inline void setGreySwizzle(uint32_t channels)
+{
+    if (channels == 1)
+    {
+        const GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    else if (channels == 2)
+    {
+        const GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+}
+
+// create a texture from a .btex file, 0 if it can't be read or was baked
+// with the other orientation than flip asks for. Sampling state comes from
+// the caller; every level is present so mipmapped filters work.
+// ------------------------------------------------------------------------
+inline GLuint loadBakedTexture(const char *path, bool flip, GLint wrap, GLint minFilter, GLint magFilter)
+{
+    PROFILE_ZONE("loadBakedTexture");
+    MappedFile file(path);
+    BakedTextureView view;
+    if (!file.data() || !parseBakedTexture(file, view))
+        return 0;
+    const BakedTextureHeader &header = *view.header;
+    if (((header.flags & BAKED_TEXTURE_FLIPPED) != 0) != flip)
+    {
+        std::cout << "WARNING::TEXTURE_CONTAINER::ORIENTATION_MISMATCH: " << path << std::endl;
+        return 0;
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLState.bindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)header.levelCount - 1);
+    setGreySwizzle(header.bytesPerPixel);
+    // rows are tightly packed in the file
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (GLExt.textureStorage)
+    {
+        // immutable storage for the whole chain, then copy each level out of the mapping
+        glTexStorage2D(GL_TEXTURE_2D, (GLsizei)header.levelCount, header.internalFormat, header.width, header.height);
+        for (uint32_t i = 0; i < header.levelCount; i++)
+            glTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, view.levels[i].width, view.levels[i].height,
+                            header.format, header.type, view.levelData(file, i));
+    }
+    else
+    {
+        for (uint32_t i = 0; i < header.levelCount; i++)
+            glTexImage2D(GL_TEXTURE_2D, (GLint)i, (GLint)header.internalFormat, view.levels[i].width, view.levels[i].height, 0,
+                         header.format, header.type, view.levelData(file, i));
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return texture;
+}
+
+// offline side: build the full mip chain of an 8-bit image and write it out
+// ------------------------------------------------------------------------
+inline void downsampleLevel(const std::vector<unsigned char> &src, uint32_t srcWidth, uint32_t srcHeight,
+                            uint32_t channels, std::vector<unsigned char> &dst, uint32_t dstWidth, uint32_t dstHeight)
+{
+    // 2x2 box filter, same as glGenerateMipmap on most drivers: an odd source
+    // size drops its last row/column, a size of 1 is clamped
+    dst.assign((size_t)dstWidth * dstHeight * channels, 0);
+    for (uint32_t y = 0; y < dstHeight; y++)
+    {
+        uint32_t y0 = std::min(y * 2, srcHeight - 1), y1 = std::min(y * 2 + 1, srcHeight - 1);
+        for (uint32_t x = 0; x < dstWidth; x++)
+        {
+            uint32_t x0 = std::min(x * 2, srcWidth - 1), x1 = std::min(x * 2 + 1, srcWidth - 1);
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                unsigned int sum = src[((size_t)y0 * srcWidth + x0) * channels + c]
+                                 + src[((size_t)y0 * srcWidth + x1) * channels + c]
+                                 + src[((size_t)y1 * srcWidth + x0) * channels + c]
+                                 + src[((size_t)y1 * srcWidth + x1) * channels + c];
+                dst[((size_t)y * dstWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+// pixels are 8-bit with 1, 2 or 4 channels (expand RGB to RGBA before calling,
+// drivers store it that way anyway); flipped records whether they were
+// loaded bottom row first. maxLevels caps the chain, 0 keeps all of it.
+// Returns false if the file can't be written.
+inline bool writeBakedTexture(const char *path, const unsigned char *pixels, uint32_t width, uint32_t height, uint32_t channels,
+                              bool flipped, uint32_t maxLevels = 0)
+{
+    static const GLenum formats[5] = { 0, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const GLenum internalFormats[5] = { 0, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    if (channels < 1 || channels > 4 || width == 0 || height == 0)
+        return false;
+
+    std::vector<std::vector<unsigned char>> chain(1);
+    std::vector<BakedLevel> levels(1);
+    chain[0].assign(pixels, pixels + (size_t)width * height * channels);
+    levels[0].width = width;
+    levels[0].height = height;
+    while ((levels.back().width > 1 || levels.back().height > 1) && (maxLevels == 0 || levels.size() < maxLevels))
+    {
+        BakedLevel next;
+        next.width = std::max(1u, levels.back().width / 2);
+        next.height = std::max(1u, levels.back().height / 2);
+        chain.emplace_back();
+        downsampleLevel(chain[chain.size() - 2], levels.back().width, levels.back().height, channels,
+                        chain.back(), next.width, next.height);
+        levels.push_back(next);
+    }
+
+    BakedTextureHeader header;
+    memcpy(header.magic, BAKED_TEXTURE_MAGIC, 8);
+    header.version = BAKED_TEXTURE_VERSION;
+    header.internalFormat = internalFormats[channels];
+    header.format = formats[channels];
+    header.type = GL_UNSIGNED_BYTE;
+    header.width = width;
+    header.height = height;
+    header.levelCount = (uint32_t)levels.size();
+    header.bytesPerPixel = channels;
+    header.flags = flipped ? BAKED_TEXTURE_FLIPPED : 0;
+    header.reserved = 0;
+
+    uint64_t offset = sizeof(header) + levels.size() * sizeof(BakedLevel);
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        offset = (offset + 15) & ~(uint64_t)15;
+        levels[i].offset = offset;
+        levels[i].size = chain[i].size();
+        offset += levels[i].size;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(levels.data(), sizeof(BakedLevel), levels.size(), file) == levels.size();
+    long position = (long)(sizeof(header) + levels.size() * sizeof(BakedLevel));
+    for (size_t i = 0; ok && i < levels.size(); i++)
+    {
+        static const char zeros[16] = {};
+        ok = fwrite(zeros, 1, (size_t)(levels[i].offset - position), file) == levels[i].offset - position
+          && fwrite(chain[i].data(), 1, chain[i].size(), file) == chain[i].size();
+        position = (long)(levels[i].offset + levels[i].size);
+    }
+    return fclose(file) == 0 && ok;
+}
+#endif
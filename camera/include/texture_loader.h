@@ -0,0 +1,275 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+// stb_image.h has no guard around its implementation, so only pull it in
+// if the including file hasn't already (possibly with STB_IMAGE_IMPLEMENTATION)
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include <stb_image.h>
+#endif
+#include "mpsc_queue.h"
+#include "texture_container.h"
+#include "cpu_profiler.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iostream>
+
+// how a texture is sampled once it is resident
+struct TextureParams
+{
+    GLint wrap = GL_REPEAT;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+    bool mipmaps = true;
+    bool flip = true;
+};
+
+// decodes images on a pool of worker threads and uploads them on the GL
+// thread. load() returns immediately with a handle; texture(handle) is a grey
+// placeholder until upload() has drained the decoded image from the
+// completion queue, after which it is the real texture.
+// If bakedDirectory is set and holds <name>.btex for an image, baked with the
+// same flip (see tools/bake_textures.cpp), that is mapped and uploaded on the
+// spot instead.
+// Workers never touch GL, and only the thread owning the context may call
+// upload(), texture() or waitAll().
+class TextureLoader
+{
+public:
+    typedef unsigned int Handle;
+
+    // where baked containers are looked up, empty to always decode
+    std::string bakedDirectory;
+
+    // threads = 0 uses one worker per hardware thread
+    // ------------------------------------------------------------------------
+    explicit TextureLoader(unsigned int threads = 0)
+    {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+        for (unsigned int i = 0; i < threads; i++)
+            workers.emplace_back(&TextureLoader::workerLoop, this);
+    }
+    // stops the workers; GL textures are left to the context like the rest of the demo
+    ~TextureLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+        for (Job *job : jobs)
+            delete job;
+        while (Job *job = completed.pop())
+        {
+            stbi_image_free(job->pixels);
+            delete job;
+        }
+    }
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // queue an image for decoding, returns a handle usable right away
+    // ------------------------------------------------------------------------
+    Handle load(const std::string &path, const TextureParams &params = TextureParams())
+    {
+        Handle handle = (Handle)entries.size();
+        entries.push_back({ path, params, 0, false, false });
+        // a baked container needs no decode, its levels go straight from the mapping to GL
+        if (!bakedDirectory.empty())
+        {
+            GLuint baked = loadBakedTexture(bakedPath(path).c_str(), params.flip, params.wrap, params.minFilter, params.magFilter);
+            if (baked)
+            {
+                entries[handle].id = baked;
+                entries[handle].resident = true;
+                return handle;
+            }
+        }
+        Job *job = new Job();
+        job->handle = handle;
+        job->path = path;
+        job->flip = params.flip;
+        inFlight++;
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            jobs.push_back(job);
+        }
+        jobReady.notify_one();
+        return handle;
+    }
+    // upload up to maxUploads decoded images, returns how many were uploaded.
+    // Call once per frame (or in a loop at startup) on the GL thread.
+    // ------------------------------------------------------------------------
+    size_t upload(size_t maxUploads = (size_t)-1)
+    {
+        PROFILE_ZONE("TextureLoader::upload");
+        size_t uploaded = 0;
+        while (uploaded < maxUploads)
+        {
+            Job *job = completed.pop();
+            if (!job)
+                break;
+            finishJob(job);
+            uploaded++;
+        }
+        return uploaded;
+    }
+    // block until every requested texture is resident or has failed
+    // ------------------------------------------------------------------------
+    void waitAll()
+    {
+        while (inFlight > 0)
+        {
+            if (upload() == 0)
+                std::this_thread::yield();
+        }
+    }
+    // the texture to bind for handle: the placeholder until the image is resident
+    // ------------------------------------------------------------------------
+    GLuint texture(Handle handle)
+    {
+        const Entry &entry = entries[handle];
+        return entry.resident ? entry.id : placeholder();
+    }
+    bool resident(Handle handle) const
+    {
+        return entries[handle].resident;
+    }
+    bool failed(Handle handle) const
+    {
+        return entries[handle].failed;
+    }
+    // number of images still decoding or waiting for upload
+    size_t pending() const
+    {
+        return inFlight;
+    }
+
+private:
+    struct Job : MPSCNode
+    {
+        Handle handle;
+        std::string path;
+        bool flip;
+        unsigned char *pixels = nullptr;
+        int width = 0, height = 0, channels = 0;
+    };
+    struct Entry
+    {
+        std::string path;
+        TextureParams params;
+        GLuint id;
+        bool resident;
+        bool failed;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<std::thread> workers;
+    std::deque<Job*> jobs;
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    bool stopping = false;
+    MPSCQueue<Job> completed;
+    size_t inFlight = 0;
+    GLuint placeholderID = 0;
+
+    // img/container.jpg -> <bakedDirectory>/container.btex
+    std::string bakedPath(const std::string &path) const
+    {
+        size_t slash = path.find_last_of('/');
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        size_t dot = name.find_last_of('.');
+        if (dot != std::string::npos)
+            name.erase(dot);
+        return bakedDirectory + "/" + name + ".btex";
+    }
+
+    void workerLoop()
+    {
+        PROFILE_THREAD("texture decode");
+        for (;;)
+        {
+            Job *job;
+            {
+                std::unique_lock<std::mutex> lock(jobMutex);
+                jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = jobs.front();
+                jobs.pop_front();
+            }
+            // the flip flag is global in stb_image unless set per thread
+            stbi_set_flip_vertically_on_load_thread(job->flip);
+            {
+                PROFILE_ZONE("stbi_load");
+                job->pixels = stbi_load(job->path.c_str(), &job->width, &job->height, &job->channels, 0);
+            }
+            completed.push(job);
+        }
+    }
+
+    void finishJob(Job *job)
+    {
+        Entry &entry = entries[job->handle];
+        inFlight--;
+        if (!job->pixels)
+        {
+            std::cout << "Failed to load texture: " << job->path << std::endl;
+            entry.failed = true;
+            delete job;
+            return;
+        }
+        GLenum format = GL_RGBA;
+        if (job->channels == 1)
+            format = GL_RED;
+        else if (job->channels == 2)
+            format = GL_RG;
+        else if (job->channels == 3)
+            format = GL_RGB;
+
+        PROFILE_ZONE("texture upload");
+        glGenTextures(1, &entry.id);
+        GLState.bindTexture(GL_TEXTURE_2D, entry.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, entry.params.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, entry.params.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, entry.params.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, entry.params.magFilter);
+        // rows of 1 and 3 channel images aren't 4-byte aligned in general
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, job->width, job->height, 0, format, GL_UNSIGNED_BYTE, job->pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        setGreySwizzle(job->channels);
+        if (entry.params.mipmaps)
+            glGenerateMipmap(GL_TEXTURE_2D);
+        entry.resident = true;
+        stbi_image_free(job->pixels);
+        delete job;
+    }
+
+    // 1x1 mid grey, created on first use
+    GLuint placeholder()
+    {
+        if (placeholderID == 0)
+        {
+            const unsigned char grey[4] = { 128, 128, 128, 255 };
+            glGenTextures(1, &placeholderID);
+            GLState.bindTexture(GL_TEXTURE_2D, placeholderID);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        }
+        return placeholderID;
+    }
+};
+#endif
@@ -0,0 +1,291 @@
+#ifndef TLSF_ALLOCATOR_H
+#define TLSF_ALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+// a handle to a range handed out by TlsfAllocator
+struct TlsfAllocation
+{
+    static const uint32_t INVALID = 0xFFFFFFFFu;
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    uint32_t block = INVALID;
+    // the block's generation when it was handed out, so a handle to a block
+    // that has since been freed, merged or reused is told apart
+    uint32_t generation = 0;
+
+    bool valid() const
+    {
+        return block != INVALID;
+    }
+};
+
+// two-level segregated fit allocator for ranges of some other memory, here
+// GPU buffers, so it keeps its bookkeeping to itself instead of in headers
+// inside the managed memory. Sizes are in whatever unit the caller picks
+// (vertices, indices, bytes). Free blocks sit in lists by size class: the
+// first level is the power of two, the second splits it into SL_COUNT
+// linear steps, and a bitmap per level finds a list big enough with two
+// bit scans. Allocation and freeing are O(1); freed blocks merge with free
+// neighbours right away, which keeps fragmentation low with many small
+// allocations of mixed sizes.
+// ------------------------------------------------------------------------
+class TlsfAllocator
+{
+public:
+    static const int SL_BITS = 4;
+    static const int SL_COUNT = 1 << SL_BITS;
+    static const int FL_COUNT = 32 - SL_BITS + 1;
+
+    void init(uint32_t capacity)
+    {
+        blocks.clear();
+        unusedBlocks.clear();
+        flBitmap = 0;
+        for (int fl = 0; fl < FL_COUNT; fl++)
+        {
+            slBitmap[fl] = 0;
+            for (int sl = 0; sl < SL_COUNT; sl++)
+                freeLists[fl][sl] = NONE;
+        }
+        totalSize = capacity;
+        usedSize = 0;
+        if (capacity == 0)
+            return;
+        uint32_t block = newBlock();
+        blocks[block].offset = 0;
+        blocks[block].size = capacity;
+        insertFree(block);
+    }
+    // an invalid allocation when nothing free is big enough
+    // ------------------------------------------------------------------------
+    TlsfAllocation allocate(uint32_t size)
+    {
+        TlsfAllocation allocation;
+        if (size == 0)
+            size = 1;
+        int fl, sl;
+        // round up to the next size class, so any block in the list fits
+        uint32_t searchSize = size;
+        if (size >= (uint32_t)SL_COUNT)
+        {
+            uint32_t round = (1u << (highestBit(size) - SL_BITS)) - 1;
+            if (searchSize > 0xFFFFFFFFu - round)
+                return allocation;
+            searchSize += round;
+        }
+        mapping(searchSize, fl, sl);
+        uint32_t block = NONE;
+        if (findFree(fl, sl))
+            block = freeLists[fl][sl];
+        else
+        {
+            // nothing in a bigger class, but the blocks in size's own class
+            // may still hold it; only happens when memory is nearly full
+            mapping(size, fl, sl);
+            for (uint32_t candidate = freeLists[fl][sl]; candidate != NONE; candidate = blocks[candidate].nextFree)
+                if (blocks[candidate].size >= size)
+                {
+                    block = candidate;
+                    break;
+                }
+            if (block == NONE)
+                return allocation;
+        }
+        removeFree(block, fl, sl);
+
+        // give the tail back as a block of its own
+        if (blocks[block].size > size)
+        {
+            uint32_t rest = newBlock();
+            Block &b = blocks[block];
+            Block &r = blocks[rest];
+            r.offset = b.offset + size;
+            r.size = b.size - size;
+            r.previous = block;
+            r.next = b.next;
+            if (b.next != NONE)
+                blocks[b.next].previous = rest;
+            b.next = rest;
+            b.size = size;
+            insertFree(rest);
+        }
+        blocks[block].free = false;
+        blocks[block].generation++;
+        usedSize += size;
+        allocation.offset = blocks[block].offset;
+        allocation.size = size;
+        allocation.block = block;
+        allocation.generation = blocks[block].generation;
+        return allocation;
+    }
+    // freeing a handle twice, or one whose block has been merged away or
+    // handed out again since, does nothing
+    // ------------------------------------------------------------------------
+    void free(const TlsfAllocation &allocation)
+    {
+        if (!allocation.valid() || allocation.block >= blocks.size() || blocks[allocation.block].free
+            || blocks[allocation.block].generation != allocation.generation)
+            return;
+        uint32_t block = allocation.block;
+        usedSize -= blocks[block].size;
+        uint32_t next = blocks[block].next;
+        if (next != NONE && blocks[next].free)
+            block = merge(block, next);
+        uint32_t previous = blocks[block].previous;
+        if (previous != NONE && blocks[previous].free)
+            block = merge(previous, block);
+        insertFree(block);
+    }
+
+    uint32_t capacity() const
+    {
+        return totalSize;
+    }
+    uint32_t used() const
+    {
+        return usedSize;
+    }
+    // the biggest single allocation that would succeed right now
+    uint32_t largestFree() const
+    {
+        if (!flBitmap)
+            return 0;
+        int fl = highestBit(flBitmap);
+        int sl = highestBit(slBitmap[fl]);
+        uint32_t largest = 0;
+        for (uint32_t block = freeLists[fl][sl]; block != NONE; block = blocks[block].nextFree)
+            if (blocks[block].size > largest)
+                largest = blocks[block].size;
+        return largest;
+    }
+
+private:
+    static const uint32_t NONE = 0xFFFFFFFFu;
+    struct Block
+    {
+        uint32_t offset = 0, size = 0;
+        // neighbours in address order, and in the block's free list
+        uint32_t previous = NONE, next = NONE;
+        uint32_t previousFree = NONE, nextFree = NONE;
+        bool free = false;
+        // bumped each time the block is handed out or merged away
+        uint32_t generation = 0;
+    };
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unusedBlocks;
+    uint32_t flBitmap = 0;
+    uint32_t slBitmap[FL_COUNT] = {};
+    uint32_t freeLists[FL_COUNT][SL_COUNT];
+    uint32_t totalSize = 0, usedSize = 0;
+
+    static int highestBit(uint32_t value)
+    {
+        return 31 - __builtin_clz(value);
+    }
+    static int lowestBit(uint32_t value)
+    {
+        return __builtin_ctz(value);
+    }
+    // sizes below SL_COUNT get one list each in the first row
+    static void mapping(uint32_t size, int &fl, int &sl)
+    {
+        if (size < (uint32_t)SL_COUNT)
+        {
+            fl = 0;
+            sl = (int)size;
+            return;
+        }
+        int msb = highestBit(size);
+        fl = msb - SL_BITS + 1;
+        sl = (int)(size >> (msb - SL_BITS)) - SL_COUNT;
+    }
+    // the first non-empty list at or above fl/sl
+    bool findFree(int &fl, int &sl) const
+    {
+        uint32_t slMap = sl < SL_COUNT ? slBitmap[fl] & (~0u << sl) : 0;
+        if (!slMap)
+        {
+            uint32_t flMap = fl + 1 < 32 ? flBitmap & (~0u << (fl + 1)) : 0;
+            if (!flMap)
+                return false;
+            fl = lowestBit(flMap);
+            slMap = slBitmap[fl];
+        }
+        sl = lowestBit(slMap);
+        return true;
+    }
+    uint32_t newBlock()
+    {
+        if (!unusedBlocks.empty())
+        {
+            uint32_t block = unusedBlocks.back();
+            unusedBlocks.pop_back();
+            uint32_t generation = blocks[block].generation;
+            blocks[block] = Block();
+            blocks[block].generation = generation;
+            return block;
+        }
+        blocks.push_back(Block());
+        return (uint32_t)(blocks.size() - 1);
+    }
+    void insertFree(uint32_t block)
+    {
+        Block &b = blocks[block];
+        int fl, sl;
+        mapping(b.size, fl, sl);
+        b.free = true;
+        b.previousFree = NONE;
+        b.nextFree = freeLists[fl][sl];
+        if (b.nextFree != NONE)
+            blocks[b.nextFree].previousFree = block;
+        freeLists[fl][sl] = block;
+        flBitmap |= 1u << fl;
+        slBitmap[fl] |= 1u << sl;
+    }
+    void removeFree(uint32_t block, int fl, int sl)
+    {
+        Block &b = blocks[block];
+        if (b.previousFree != NONE)
+            blocks[b.previousFree].nextFree = b.nextFree;
+        else
+            freeLists[fl][sl] = b.nextFree;
+        if (b.nextFree != NONE)
+            blocks[b.nextFree].previousFree = b.previousFree;
+        if (freeLists[fl][sl] == NONE)
+        {
+            slBitmap[fl] &= ~(1u << sl);
+            if (!slBitmap[fl])
+                flBitmap &= ~(1u << fl);
+        }
+        b.free = false;
+        b.previousFree = b.nextFree = NONE;
+    }
+    // joins second into first, its neighbour; second may be free, first is
+    // taken off its free list if it is on one
+    uint32_t merge(uint32_t first, uint32_t second)
+    {
+        int fl, sl;
+        if (blocks[first].free)
+        {
+            mapping(blocks[first].size, fl, sl);
+            removeFree(first, fl, sl);
+        }
+        if (blocks[second].free)
+        {
+            mapping(blocks[second].size, fl, sl);
+            removeFree(second, fl, sl);
+        }
+        Block &a = blocks[first];
+        Block &b = blocks[second];
+        a.size += b.size;
+        a.next = b.next;
+        if (b.next != NONE)
+            blocks[b.next].previous = first;
+        b.generation++;
+        unusedBlocks.push_back(second);
+        return first;
+    }
+};
+#endif
@@ -0,0 +1,134 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "stream_buffer.h"
+
+#include <cstddef>
+#include <cstring>
+
+// fixed binding points of the shared uniform and shader storage blocks.
+// GLSL 3.30 can't say layout(binding = N), so Shader assigns these by block
+// name after linking.
+enum UniformBlockBinding
+{
+    CAMERA_BLOCK_BINDING = 0
+};
+enum StorageBlockBinding
+{
+    OBJECT_STORAGE_BINDING = 0
+};
+
+struct UniformBlockName
+{
+    const char *name;
+    GLuint binding;
+};
+
+static const UniformBlockName UNIFORM_BLOCKS[] = {
+    { "Camera", CAMERA_BLOCK_BINDING }
+};
+static const UniformBlockName STORAGE_BLOCKS[] = {
+    { "Objects", OBJECT_STORAGE_BINDING }
+};
+
+// point every known block the program uses at its binding
+// ------------------------------------------------------------------------
+inline void bindShaderBlocks(GLuint program)
+{
+    for (const UniformBlockName &block : UNIFORM_BLOCKS)
+    {
+        GLuint index = glGetUniformBlockIndex(program, block.name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, block.binding);
+    }
+    if (!GLExt.shaderStorage)
+        return;
+    for (const UniformBlockName &block : STORAGE_BLOCKS)
+    {
+        GLuint index = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, block.name);
+        if (index != GL_INVALID_INDEX)
+            glShaderStorageBlockBinding(program, index, block.binding);
+    }
+}
+
+// mirrors, member for member, the block every vertex shader declares:
+//
+//   layout (std140) uniform Camera
+//   {
+//       mat4 view;
+//       mat4 projection;
+//       mat4 viewProjection;
+//       vec4 cameraPosition;
+//       float time;
+//   };
+//
+// std140 puts mat4 on 16 byte columns and rounds the block up to 16 bytes,
+// which glm's layout happens to match; the asserts keep it that way.
+struct CameraBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition;   // w unused
+    float time;
+    float padding[3];
+};
+static_assert(offsetof(CameraBlock, view) == 0, "std140 offset of Camera.view");
+static_assert(offsetof(CameraBlock, projection) == 64, "std140 offset of Camera.projection");
+static_assert(offsetof(CameraBlock, viewProjection) == 128, "std140 offset of Camera.viewProjection");
+static_assert(offsetof(CameraBlock, cameraPosition) == 192, "std140 offset of Camera.cameraPosition");
+static_assert(offsetof(CameraBlock, time) == 208, "std140 offset of Camera.time");
+static_assert(sizeof(CameraBlock) == 224, "std140 size of Camera");
+
+// a buffer holding one T, attached to a uniform block binding point; update()
+// rewrites it, once per frame for per-frame data. Given a StreamBuffer the
+// value goes into this frame's region instead and the binding points there,
+// so the write never waits on draws still reading last frame's copy.
+// ------------------------------------------------------------------------
+template<typename T>
+class UniformBuffer
+{
+public:
+    GLuint ID = 0;
+
+    void init(GLuint binding)
+    {
+        this->binding = binding;
+        glGenBuffers(1, &ID);
+        GLState.bindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        GLState.bindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+    void update(const T &data)
+    {
+        GLState.bindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+    }
+    void update(const T &data, StreamBuffer &stream)
+    {
+        StreamSpan span = stream.allocateUniform(sizeof(T));
+        if (!span)
+        {
+            update(data);
+            GLState.bindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+            return;
+        }
+        memcpy(span.data, &data, sizeof(T));
+        stream.flush();
+        GLState.bindBufferRange(GL_UNIFORM_BUFFER, binding, stream.ID, span.offset, span.size);
+    }
+    void destroy()
+    {
+        GLState.bufferDeleted(ID);
+        glDeleteBuffers(1, &ID);
+        ID = 0;
+    }
+
+private:
+    GLuint binding = 0;
+};
+#endif
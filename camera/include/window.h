@@ -0,0 +1,384 @@
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include <glad/glad.h>
+#ifndef HEADLESS_ONLY
+#include <GLFW/glfw3.h>
+#else
+// built without GLFW (make HEADLESS=1): the key codes the demo asks for, with
+// GLFW's values. Offscreen windows never report a key as pressed.
+#define GLFW_KEY_A 65
+#define GLFW_KEY_D 68
+#define GLFW_KEY_S 83
+#define GLFW_KEY_W 87
+#define GLFW_KEY_ESCAPE 256
+#endif
+#include "gl_ext.h"
+#include "gl_state.h"
+
+// keep eglplatform.h from pulling in Xlib
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <iostream>
+
+typedef void (*CursorPosCallback)(double xpos, double ypos);
+typedef void (*ScrollCallback)(double xoffset, double yoffset);
+
+// where frames go: an on-screen GLFW window or an offscreen EGL context. The
+// render loop only talks to this, so it runs unchanged on a desktop and on a
+// display-less server. Key codes are GLFW's.
+// ------------------------------------------------------------------------
+class Window
+{
+public:
+    int width = 0, height = 0;
+    // stop after this many frames, 0 runs until closed
+    unsigned long frameLimit = 0;
+    unsigned long frameCount = 0;
+
+    virtual ~Window() {}
+
+    // entry point loader for glad and loadGLExtensions
+    virtual GLADloadproc loader() const = 0;
+    // the framebuffer that stands in for the default one; 0 for a real window
+    virtual GLuint framebuffer() const = 0;
+    // seconds since the window was created
+    virtual double time() const = 0;
+    virtual bool keyPressed(int key) const = 0;
+    virtual void requestClose() = 0;
+    virtual void pollEvents() = 0;
+    virtual void setCursorPosCallback(CursorPosCallback callback) = 0;
+    virtual void setScrollCallback(ScrollCallback callback) = 0;
+    // hide the cursor and report unbounded motion (mouse look)
+    virtual void captureCursor() = 0;
+
+    bool shouldClose() const
+    {
+        return closeRequested() || (frameLimit != 0 && frameCount >= frameLimit);
+    }
+    void swapBuffers()
+    {
+        frameCount++;
+        present();
+    }
+    // RGBA8 copy of the current frame, bottom row first
+    void readPixels(std::vector<unsigned char> &pixels) const
+    {
+        pixels.resize((size_t)width * height * 4);
+        GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer());
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    }
+    // write the current frame as a binary PPM
+    bool saveScreenshot(const char *path) const
+    {
+        std::vector<unsigned char> pixels;
+        readPixels(pixels);
+        FILE *file = fopen(path, "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::WINDOW::SCREENSHOT_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        std::vector<unsigned char> row((size_t)width * 3);
+        bool ok = true;
+        for (int y = height - 1; y >= 0 && ok; y--)
+        {
+            const unsigned char *src = &pixels[(size_t)y * width * 4];
+            for (int x = 0; x < width; x++)
+                memcpy(&row[(size_t)x * 3], &src[(size_t)x * 4], 3);
+            ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+        }
+        return fclose(file) == 0 && ok;
+    }
+
+protected:
+    virtual bool closeRequested() const = 0;
+    virtual void present() = 0;
+};
+
+#ifndef HEADLESS_ONLY
+// on-screen window through GLFW
+// ------------------------------------------------------------------------
+class GlfwWindow : public Window
+{
+public:
+    bool create(int w, int h, const char *title, int major, int minor)
+    {
+        if (!glfwInit())
+        {
+            std::cout << "Failed to initialize GLFW" << std::endl;
+            return false;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        handle = glfwCreateWindow(w, h, title, NULL, NULL);
+        if (handle == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return false;
+        }
+        glfwMakeContextCurrent(handle);
+        glfwSetWindowUserPointer(handle, this);
+        glfwGetFramebufferSize(handle, &width, &height);
+        glfwSetFramebufferSizeCallback(handle, framebufferSizeCallback);
+        return true;
+    }
+    ~GlfwWindow()
+    {
+        if (handle)
+            glfwTerminate();
+    }
+
+    GLADloadproc loader() const override { return (GLADloadproc)glfwGetProcAddress; }
+    GLuint framebuffer() const override { return 0; }
+    double time() const override { return glfwGetTime(); }
+    bool keyPressed(int key) const override { return glfwGetKey(handle, key) == GLFW_PRESS; }
+    void requestClose() override { glfwSetWindowShouldClose(handle, true); }
+    void pollEvents() override { glfwPollEvents(); }
+    void setCursorPosCallback(CursorPosCallback callback) override
+    {
+        cursorPos = callback;
+        glfwSetCursorPosCallback(handle, cursorPosCallback);
+    }
+    void setScrollCallback(ScrollCallback callback) override
+    {
+        scroll = callback;
+        glfwSetScrollCallback(handle, scrollCallback);
+    }
+    void captureCursor() override { glfwSetInputMode(handle, GLFW_CURSOR, GLFW_CURSOR_DISABLED); }
+
+protected:
+    bool closeRequested() const override { return glfwWindowShouldClose(handle); }
+    void present() override { glfwSwapBuffers(handle); }
+
+private:
+    GLFWwindow *handle = NULL;
+    CursorPosCallback cursorPos = NULL;
+    ScrollCallback scroll = NULL;
+
+    static GlfwWindow *self(GLFWwindow *window)
+    {
+        return (GlfwWindow *)glfwGetWindowUserPointer(window);
+    }
+    // make sure the viewport matches the new window dimensions; note that width and
+    // height will be significantly larger than specified on retina displays.
+    static void framebufferSizeCallback(GLFWwindow *window, int w, int h)
+    {
+        self(window)->width = w;
+        self(window)->height = h;
+        GLState.viewport(0, 0, w, h);
+    }
+    static void cursorPosCallback(GLFWwindow *window, double xpos, double ypos)
+    {
+        self(window)->cursorPos(xpos, ypos);
+    }
+    static void scrollCallback(GLFWwindow *window, double xoffset, double yoffset)
+    {
+        self(window)->scroll(xoffset, yoffset);
+    }
+};
+#endif
+
+// offscreen rendering without a display server: an EGL context on the
+// surfaceless platform (Mesa, works with llvmpipe), or a pbuffer on the
+// default display where that isn't available. Frames go into an FBO that is
+// left bound, so draws meant for the window land in it unchanged.
+// ------------------------------------------------------------------------
+class HeadlessWindow : public Window
+{
+public:
+    bool create(int w, int h, int major, int minor)
+    {
+        width = w;
+        height = h;
+        start = std::chrono::steady_clock::now();
+
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        bool surfaceless = getPlatformDisplay && clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless");
+        display = surfaceless ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL)
+                              : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+        {
+            std::cout << "ERROR::HEADLESS::NO_EGL_DISPLAY" << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cout << "ERROR::HEADLESS::NO_DESKTOP_GL" << std::endl;
+            return false;
+        }
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0)
+        {
+            std::cout << "ERROR::HEADLESS::NO_EGL_CONFIG" << std::endl;
+            return false;
+        }
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT)
+        {
+            std::cout << "ERROR::HEADLESS::CONTEXT_CREATION_FAILED: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        // rendering goes to the FBO, a pbuffer is only there to make the context current
+        if (!surfaceless)
+        {
+            const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+        }
+        if (!eglMakeCurrent(display, surface, surface, context))
+        {
+            std::cout << "ERROR::HEADLESS::MAKE_CURRENT_FAILED: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        return true;
+    }
+    // the FBO needs GL entry points, so this runs after glad is loaded
+    bool createFramebuffer()
+    {
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &fbo);
+        GLState.bindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+            return false;
+        }
+        GLState.viewport(0, 0, width, height);
+        return true;
+    }
+    ~HeadlessWindow()
+    {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        if (fbo)
+        {
+            GLState.framebufferDeleted(fbo);
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+        }
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+    }
+
+    GLADloadproc loader() const override { return (GLADloadproc)eglGetProcAddress; }
+    GLuint framebuffer() const override { return fbo; }
+    double time() const override
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    bool keyPressed(int key) const override { return false; }
+    void requestClose() override { closing = true; }
+    void pollEvents() override {}
+    void setCursorPosCallback(CursorPosCallback callback) override {}
+    void setScrollCallback(ScrollCallback callback) override {}
+    void captureCursor() override {}
+
+protected:
+    bool closeRequested() const override { return closing; }
+    // nothing to show; flush so the frame is actually submitted like a swap would
+    void present() override { glFlush(); }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    std::chrono::steady_clock::time_point start;
+    bool closing = false;
+};
+
+// make a window with a current GL major.minor core context and load glad and
+// the extension entry points into it; NULL on failure
+// ------------------------------------------------------------------------
+inline Window *createWindow(bool headless, int w, int h, const char *title, int major = 3, int minor = 3)
+{
+    Window *window = NULL;
+#ifdef HEADLESS_ONLY
+    if (!headless)
+        std::cout << "built with HEADLESS=1, rendering offscreen" << std::endl;
+    headless = true;
+#endif
+    if (headless)
+    {
+        HeadlessWindow *offscreen = new HeadlessWindow();
+        if (!offscreen->create(w, h, major, minor))
+        {
+            delete offscreen;
+            return NULL;
+        }
+        window = offscreen;
+    }
+#ifndef HEADLESS_ONLY
+    else
+    {
+        GlfwWindow *onscreen = new GlfwWindow();
+        if (!onscreen->create(w, h, title, major, minor))
+        {
+            delete onscreen;
+            return NULL;
+        }
+        window = onscreen;
+    }
+#endif
+
+    // glad: load all OpenGL function pointers
+    if (!gladLoadGLLoader(window->loader()))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        delete window;
+        return NULL;
+    }
+    // load the post-3.3 entry points (program binaries, ...) the context offers
+    loadGLExtensions(window->loader());
+    if (headless && !((HeadlessWindow *)window)->createFramebuffer())
+    {
+        delete window;
+        return NULL;
+    }
+    return window;
+}
+#endif
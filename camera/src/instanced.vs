@@ -0,0 +1,37 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+// per instance, see Instance in include/instanced_renderer.h
+layout (location = 2) in vec4 aPositionScale;
+layout (location = 3) in vec4 aAxisAngle;
+
+out vec2 TexCoord;
+
+// shared by every program, see CameraBlock in include/uniform_blocks.h
+layout (std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+	float time;
+};
+
+uniform float angularSpeed;
+
+// same matrix as glm::rotate(mat4(1.0f), angle, axis)
+mat3 rotation(vec3 axis, float angle) {
+	float c = cos(angle);
+	float s = sin(angle);
+	vec3 t = (1.0 - c) * axis;
+	return mat3(c + t.x * axis.x,          t.x * axis.y + s * axis.z, t.x * axis.z - s * axis.y,
+	            t.y * axis.x - s * axis.z, c + t.y * axis.y,          t.y * axis.z + s * axis.x,
+	            t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x, c + t.z * axis.z);
+}
+
+void main() {
+	mat3 rotate = rotation(normalize(aAxisAngle.xyz), aAxisAngle.w + angularSpeed * time);
+	vec3 worldPos = aPositionScale.xyz + rotate * (aPos * aPositionScale.w);
+	gl_Position = viewProjection * vec4(worldPos, 1.0);
+	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+}
@@ -1,28 +1,59 @@
 #include <glm/geometric.hpp>
 #define STB_IMAGE_IMPLEMENTATION
 #include <glad/glad.h>
+#ifndef HEADLESS_ONLY
 #include <GLFW/glfw3.h>
+#endif
 #include <stb_image.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 
 //#include "../include/shader_s.h"
 #include "../include/shader_m.h"
+#include "../include/shader_batch.h"
+#include "../include/texture_loader.h"
+#include "../include/instanced_renderer.h"
+#include "../include/mesh.h"
+#include "../include/window.h"
+#include "../include/camera_path.h"
+#include "../include/benchmark.h"
+#include "../include/gpu_profiler.h"
+#include "../include/cpu_profiler.h"
+#include "../include/gl_trace.h"
+#include "../include/uniform_blocks.h"
+#include "../include/object_buffer.h"
+#include "../include/mesh_arena.h"
+#include "../include/draw_indirect.h"
+#include "../include/frustum_cull.h"
+#include "../include/job_system.h"
+#include "../include/render_queue.h"
+#include "../include/stream_buffer.h"
+#include "../include/frame_capture.h"
+#include "../include/soft_rasterizer.h"
+#include "../include/frame_graph.h"
+#include "../include/atlas.h"
 
 #include <iostream>
 
-void framebuffer_size_callback(GLFWwindow * window, int width, int height);
-void processInput(GLFWwindow * window);
-void mouseCallback(GLFWwindow * window, double xpos, double ypos);
-void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(Window * window);
+void mouseCallback(double xpos, double ypos);
+void scrollCallback(double xoffset, double yoffset);
 
 // settings
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
+// frames an offscreen run renders when neither --frames nor --benchmark says
+const unsigned long HEADLESS_FRAMES = 120;
+// sprites --atlas hands out, the size of spriteRects in src/objects.vs
+const int ATLAS_SPRITES = 8;
 
 glm::vec3 cameraPos     = glm::vec3(0.0f, 0.0f,  3.0f);
 glm::vec3 cameraFront   = glm::vec3(0.0f, 0.0f, -1.0f);
@@ -36,37 +67,183 @@ float yaw, pitch, fov = 45.0f;
 
 bool firstMouse = true;
 
-int main() {
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// how the cube field is submitted
+enum RenderPath {
+    PATH_PER_OBJECT,    // one model uniform and one draw per cube
+    PATH_INSTANCED,     // one instanced draw for every cube
+    PATH_OBJECT_DATA,   // model matrices in one buffer, fetched by instance in one draw
+    PATH_INDIRECT,      // cubes and pyramids from one mesh pool in one multi-draw indirect
+    PATH_QUEUE          // per-object draws of mixed state, sorted by a render queue
+};
+
+std::vector<Instance> buildCubeField(const glm::vec3 *positions, size_t positionCount, size_t count);
 
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+int main(int argc, char **argv) {
+    // command line: --cubes N sets the size of the cube field, --path picks how it is drawn,
+    // --headless renders offscreen without a display, --frames N stops after N frames and
+    // --screenshot FILE saves the last frame as a PPM. --benchmark PATH flies the camera
+    // along a scripted path with a fixed --dt and writes frame times to --benchmark-out.
+    // --gpu-profile FILE times each pass on the GPU and writes the statistics at exit,
+    // --cpu-trace FILE writes the CPU zones as a Chrome trace at exit (needs make PROFILE=1),
+    // --no-cull draws every object even when it is outside the view frustum,
+    // --threads N runs per-frame CPU work on N threads (default: one per core),
+    // --no-stream uploads per-frame data with glBufferSubData instead of a mapped ring,
+    // --capture PATH records every frame to PATH.y4m, or to PATH_000000.png and on, until
+    // the window is resized,
+    // --software draws the cubes with the CPU rasterizer instead of GL (ignores --path),
+    // --bloom renders the cubes offscreen and adds a bright pass, blur and composite,
+    // --atlas textures each object with a sprite from baked/sprites.atlas (make atlas;
+    // --path objects and indirect),
+    // --no-indirect replays --path indirect one draw at a time as on contexts without
+    // multi-draw indirect or shader draw parameters,
+    // --no-program-cache links every program from source and writes no cache entries,
+    // to compare a cold start with a warm one
+    size_t cubeCount = 10;
+    RenderPath renderPath = PATH_INSTANCED;
+    bool headless = false;
+    unsigned long frameLimit = 0;
+    const char *screenshotPath = NULL;
+    const char *benchmarkPath = NULL;
+    const char *benchmarkOut = "benchmark.json";
+    float fixedDelta = 1.0f / 60.0f;
+    const char *gpuProfilePath = NULL;
+    const char *cpuTracePath = NULL;
+    bool culling = true;
+    bool streaming = true;
+    unsigned int threadCount = 0;
+    const char *capturePath = NULL;
+    bool software = false;
+    bool bloom = false;
+    bool useAtlas = false;
+    bool forceDrawFallback = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cubes") == 0 && i + 1 < argc)
+            cubeCount = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameLimit = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--screenshot") == 0 && i + 1 < argc)
+            screenshotPath = argv[++i];
+        else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+            benchmarkPath = argv[++i];
+        else if (strcmp(argv[i], "--benchmark-out") == 0 && i + 1 < argc)
+            benchmarkOut = argv[++i];
+        else if (strcmp(argv[i], "--dt") == 0 && i + 1 < argc)
+            fixedDelta = strtof(argv[++i], NULL);
+        else if (strcmp(argv[i], "--gpu-profile") == 0 && i + 1 < argc)
+            gpuProfilePath = argv[++i];
+        else if (strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc)
+            cpuTracePath = argv[++i];
+        else if (strcmp(argv[i], "--no-cull") == 0)
+            culling = false;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threadCount = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--no-stream") == 0)
+            streaming = false;
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            capturePath = argv[++i];
+        else if (strcmp(argv[i], "--software") == 0)
+            software = true;
+        else if (strcmp(argv[i], "--bloom") == 0)
+            bloom = true;
+        else if (strcmp(argv[i], "--atlas") == 0)
+            useAtlas = true;
+        else if (strcmp(argv[i], "--no-indirect") == 0)
+            forceDrawFallback = true;
+        else if (strcmp(argv[i], "--no-program-cache") == 0)
+            ProgramCache::enabled = false;
+        else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "per-object") == 0)
+                renderPath = PATH_PER_OBJECT;
+            else if (strcmp(argv[i], "instanced") == 0)
+                renderPath = PATH_INSTANCED;
+            else if (strcmp(argv[i], "objects") == 0)
+                renderPath = PATH_OBJECT_DATA;
+            else if (strcmp(argv[i], "indirect") == 0)
+                renderPath = PATH_INDIRECT;
+            else if (strcmp(argv[i], "queue") == 0)
+                renderPath = PATH_QUEUE;
+            else
+                std::cout << "Unknown render path " << argv[i] << std::endl;
+        }
+    }
+
+#ifdef HEADLESS_ONLY
+    // built without GLFW (make HEADLESS=1), there is no on-screen window to open
+    headless = true;
 #endif
 
-    // glfw window creation
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    PROFILE_THREAD("main");
+    if (cpuTracePath && !CpuProfiler::COMPILED_IN)
+        std::cout << "--cpu-trace: built without CPU_PROFILE, the trace will be empty (make PROFILE=1)" << std::endl;
+
+    CameraPath cameraPath;
+    if (benchmarkPath) {
+        if (!cameraPath.load(benchmarkPath))
+            return -1;
+        // without --frames, play the path once
+        if (frameLimit == 0)
+            frameLimit = (unsigned long)ceil(cameraPath.duration() / fixedDelta) + 1;
+    }
+    // nothing ever closes an offscreen window, so it stops on its own
+    if (headless && frameLimit == 0) {
+        frameLimit = HEADLESS_FRAMES;
+        std::cout << "--headless without --frames: stopping after " << frameLimit << " frames" << std::endl;
+    }
+    // the screenshot is taken of the last frame, which needs to be known
+    if (screenshotPath && frameLimit == 0) {
+        std::cout << "--screenshot needs --frames N (or --benchmark) to know which frame is the last" << std::endl;
         return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouseCallback);
-    glfwSetScrollCallback(window, scrollCallback);
-
-    // glad: load all OpenGL function pointers
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+
+    // a GLFW window, or an offscreen EGL context and framebuffer when headless;
+    // either way glad and the extension entry points are loaded on return
+    Window *window = createWindow(headless, SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL");
+    if (window == NULL)
         return -1;
+    window->frameLimit = frameLimit;
+    // --no-indirect: pretend the context lacks what DrawBuilder and the object
+    // shader need, before either looks at GLExt
+    if (forceDrawFallback) {
+        GLExt.multiDrawIndirect = false;
+        GLExt.shaderDrawParameters = false;
+    }
+    // count every GL call from here on (debug builds only)
+    GL_TRACE_INSTALL();
+    // a benchmark is flown by its script alone: no mouse look, no zoom
+    if (!benchmarkPath) {
+        window->setCursorPosCallback(mouseCallback);
+        window->setScrollCallback(scrollCallback);
     }
 
-    // build and compile our shader zprogram
-    Shader ourShader("src/shader.vs", "src/shader.fs");
+    // --atlas: the packed sprites are one baked texture, mapped and uploaded
+    // here; without it (or without make atlas) the objects keep texture1/2
+    TextureAtlas spriteAtlas;
+    if (useAtlas && !(renderPath == PATH_OBJECT_DATA || renderPath == PATH_INDIRECT)) {
+        std::cout << "--atlas only applies to --path objects and indirect" << std::endl;
+        useAtlas = false;
+    }
+    if (useAtlas && (!spriteAtlas.load("baked/sprites.atlas") || spriteAtlas.allRegions().empty()))
+        useAtlas = false;
+    std::string objectDefines = ObjectBuffer::defines();
+    if (useAtlas)
+        objectDefines += "#define ATLAS\n#define ATLAS_SPRITES " + std::to_string(ATLAS_SPRITES) + "\n";
+
+    // build and compile our shader zprogram; the batch lets the driver compile
+    // while the textures below are loading, the results are gathered after
+    ShaderBatch shaderBatch;
+    shaderBatch.add("src/shader.vs", "src/shader.fs");
+    shaderBatch.add("src/instanced.vs", "src/shader.fs");
+    shaderBatch.add("src/objects.vs", "src/objects.fs", objectDefines);
+    shaderBatch.add("src/shader.vs", "src/shader.fs", "#define TRANSLUCENT\n");
+    if (bloom) {
+        shaderBatch.add("src/post.vs", "src/post.fs", "#define BRIGHT\n");
+        shaderBatch.add("src/post.vs", "src/post.fs", "#define BLUR\n");
+        shaderBatch.add("src/post.vs", "src/post.fs");
+    }
+    shaderBatch.submit();
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     float vertices[] = {
@@ -124,72 +301,70 @@ int main() {
 			glm::vec3( 1.5f,  0.2f, -1.5f), 
 			glm::vec3(-1.3f,  1.0f, -1.5f)  
 		};
-    unsigned int indices[] = {
-        0, 1, 3, // first triangle
-        1, 2, 3  // second triangle
+    // a square pyramid with the same layout, the second mesh of --path indirect
+    float pyramidVertices[] = {
+        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+         0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+         0.5f, -0.5f,  0.5f,  1.0f, 1.0f,
+         0.5f, -0.5f,  0.5f,  1.0f, 1.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f, 1.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+
+        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+         0.0f,  0.5f,  0.0f,  0.5f, 1.0f,
+
+         0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+         0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+         0.0f,  0.5f,  0.0f,  0.5f, 1.0f,
+
+         0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+        -0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+         0.0f,  0.5f,  0.0f,  0.5f, 1.0f,
+
+        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+        -0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+         0.0f,  0.5f,  0.0f,  0.5f, 1.0f
     };
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // texture coord attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // load and create a texture 
-    unsigned int texture1, texture2;
-    // texture 1
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1); 
-     // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    // load image, create texture and generate mipmaps
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-    // The FileSystem::getPath(...) is part of the GitHub repository so we can find files on any IDE/platform; replace it with your own image path.
-    unsigned char *data = stbi_load("img/container.jpg", &width, &height, &nrChannels, 0);
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
-    // texture 2
-    glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    // load image, create texture and generate mipmaps
-    data = stbi_load("img/dicaprioLaugh.png", &width, &height, &nrChannels, 0);
-    if (data) {
-        // note that the awesomeface.png has transparency and thus an alpha channel, so make sure to tell OpenGL the data type is of GL_RGBA
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    // weld the 36 listed vertices into an indexed mesh ordered for the vertex
+    // cache; position at location 0, texture coords at location 1
+    MeshData cubeData = buildIndexedMesh(vertices, sizeof(vertices) / sizeof(float) / 5, 5);
+    // the instanced path keeps a VAO of its own, InstancedRenderer adds its
+    // per-instance attributes to it
+    Mesh cubeMesh;
+    cubeMesh.upload(cubeData, { 3, 2 });
+    // every other path draws from one arena holding all the static meshes:
+    // one VAO and one pair of buffers, so changing meshes binds nothing
+    MeshArena meshArena;
+    meshArena.init({ 3, 2 }, 1 << 16, 1 << 18);
+    MeshHandle cubeHandle = meshArena.add(cubeData);
+    MeshHandle pyramidHandle = meshArena.add(buildIndexedMesh(pyramidVertices, sizeof(pyramidVertices) / sizeof(float) / 5, 5));
+
+    // the cube field: the hand placed cubes first, then a generated grid when
+    // more are asked for. Each cube's instance data is uploaded once.
+    std::vector<Instance> cubes = buildCubeField(cubePositions, sizeof(cubePositions) / sizeof(cubePositions[0]), cubeCount);
+    const float cubeSpin = (float)(M_PI / 10);
+    InstancedRenderer cubeRenderer;
+    cubeRenderer.init(cubeMesh.VAO);
+    cubeRenderer.setInstances(cubes);
+
+    // decode the textures on worker threads; until they are uploaded the loader
+    // hands out a placeholder so the first frames don't wait on stbi_load
+    TextureLoader textureLoader;
+    // images baked with make bake skip decoding and mip generation entirely
+    textureLoader.bakedDirectory = "baked";
+    TextureParams nearest;
+    nearest.minFilter = GL_NEAREST;
+    nearest.magFilter = GL_NEAREST;
+    TextureLoader::Handle texture1 = textureLoader.load("img/container.jpg", nearest);
+    TextureLoader::Handle texture2 = textureLoader.load("img/dicaprioLaugh.png", nearest);
+
+    // collect the compiled shaders, blocking only if the driver isn't done yet
+    std::vector<Shader> &shaders = shaderBatch.finish();
+    Shader ourShader = shaders[0];
+    Shader instancedShader = shaders[1];
+    Shader objectShader = shaders[2];
+    Shader translucentShader = shaders[3];
 
     // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
     ourShader.use(); // don't forget to activate/use the shader before setting uniforms!
@@ -198,6 +373,140 @@ int main() {
     // or set it via the texture class
     ourShader.setInt("texture2", 1);
 
+    // resolve the per-frame uniforms once instead of looking them up by name every draw
+    Uniform<glm::mat4> modelUniform = ourShader.uniform<glm::mat4>("model");
+    Uniform<glm::mat4> transformUniform = ourShader.uniform<glm::mat4>("transform");
+
+    instancedShader.use();
+    instancedShader.setInt("texture1", 0);
+    instancedShader.setInt("texture2", 1);
+    Uniform<float> instancedSpinUniform = instancedShader.uniform<float>("angularSpeed");
+
+    // every cube's model matrix and material in one buffer, rewritten once a frame
+    objectShader.use();
+    objectShader.setInt("texture1", 0);
+    objectShader.setInt("texture2", 1);
+    // each sprite's UV rectangle, looked up by material
+    unsigned int spriteCount = 0;
+    if (useAtlas) {
+        objectShader.setInt("atlas", 0);
+        const std::vector<AtlasRegion> &regions = spriteAtlas.allRegions();
+        spriteCount = (unsigned int)std::min(regions.size(), (size_t)ATLAS_SPRITES);
+        for (unsigned int i = 0; i < spriteCount; i++)
+            objectShader.uniform<glm::vec4>("spriteRects[" + std::to_string(i) + "]")
+                .set(glm::vec4(regions[i].uvMin.x, regions[i].uvMin.y, regions[i].uvMax.x, regions[i].uvMax.y));
+    }
+    // only used by --path queue
+    translucentShader.use();
+    translucentShader.setInt("texture1", 0);
+    translucentShader.setInt("texture2", 1);
+    translucentShader.setFloat("opacity", 0.5f);
+    Uniform<glm::mat4> translucentModelUniform = translucentShader.uniform<glm::mat4>("model");
+    Uniform<glm::mat4> translucentTransformUniform = translucentShader.uniform<glm::mat4>("transform");
+    // only used by --bloom; the full screen triangle needs a VAO bound but no attributes
+    Shader brightShader, blurShader, compositeShader;
+    Uniform<glm::vec2> blurStepUniform;
+    GLuint postVAO = 0;
+    if (bloom) {
+        brightShader = shaders[4];
+        blurShader = shaders[5];
+        compositeShader = shaders[6];
+        brightShader.use();
+        brightShader.setInt("source", 0);
+        brightShader.setFloat("threshold", 0.6f);
+        blurShader.use();
+        blurShader.setInt("source", 0);
+        blurStepUniform = blurShader.uniform<glm::vec2>("texelStep");
+        compositeShader.use();
+        compositeShader.setInt("source", 0);
+        compositeShader.setInt("bloom", 1);
+        compositeShader.setFloat("intensity", 0.8f);
+        glGenVertexArrays(1, &postVAO);
+    }
+    // only one of these is active, depending on ObjectBuffer::defines()
+    objectShader.setInt("objectTexels", ObjectBuffer::TEXTURE_UNIT);
+    objectShader.setInt("baseObject", 0);
+    GLint baseObjectLocation = objectShader.getLocation("baseObject");
+    ObjectBuffer objectBuffer;
+    std::vector<ObjectData> objects;
+    // culling and filling objects are split across workers; only this thread
+    // touches GL, the jobs just write CPU-side arrays
+    JobSystem jobs(threadCount);
+    // the cubes to draw this frame, objects[i] belongs to cubes[visible[i]]. A
+    // sphere around each cube bounds it at any rotation, so the bounds are
+    // built once; the instanced path animates on the GPU and isn't culled.
+    BoundingSpheres cubeBounds;
+    cubeBounds.resize(cubes.size());
+    for (size_t i = 0; i < cubes.size(); i++)
+        cubeBounds.set(i, cubes[i].position, cubes[i].scale * 0.8660254f);
+    std::vector<uint32_t> visible(cubeBounds.paddedSize());
+    for (size_t i = 0; i < cubes.size(); i++)
+        visible[i] = (uint32_t)i;
+    size_t visibleCount = cubes.size();
+    double visibleTotal = 0.0;
+    double softTrianglesTotal = 0.0;
+    // --path indirect: every other object is a pyramid, objects are grouped
+    // by mesh so each mesh is one indirect command
+    DrawBuilder drawBuilder;
+    size_t cubeObjects = cubes.size();
+    if (renderPath == PATH_OBJECT_DATA || renderPath == PATH_INDIRECT) {
+        objectBuffer.init(cubes.size());
+        objects.resize(cubes.size());
+    }
+    // --path queue: the same cubes and pyramids, two texture sets and some of
+    // them translucent, so every draw has state to sort by
+    RenderQueue renderQueue;
+    if (renderPath == PATH_QUEUE) {
+        renderQueue.reserve(cubes.size());
+    }
+    if (renderPath == PATH_INDIRECT)
+        drawBuilder.init();
+    // everything rewritten each frame goes through one ring of mapped
+    // buffer regions: the camera block, and the object data when it is
+    // read as a storage buffer
+    StreamBuffer streamBuffer;
+    if (streaming) {
+        size_t streamBytes = 4096;
+        if (renderPath == PATH_OBJECT_DATA || renderPath == PATH_INDIRECT)
+            streamBytes += cubes.size() * sizeof(ObjectData);
+        streamBuffer.init(streamBytes);
+    }
+
+    // frames are read back asynchronously and encoded on threads of their own
+    FrameCapture frameCapture;
+    if (capturePath) {
+        int fps = benchmarkPath ? (int)lroundf(1.0f / fixedDelta) : 60;
+        frameCapture.start(capturePath, window->width, window->height, fps);
+    }
+
+    // --software: the cubes are rasterized on the CPU across the job system, and
+    // all GL does per frame is upload the image to a texture and blit it
+    SoftRasterizer softRasterizer;
+    SoftTexture softTextures[2];
+    GLuint softTexture = 0, softFramebuffer = 0;
+    // the size the rasterizer and softTexture were made for, followed when the window resizes
+    int softWidth = window->width, softHeight = window->height;
+    if (software) {
+        softRasterizer.resize(softWidth, softHeight);
+        softRasterizer.setClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        softTextures[0].load("img/container.jpg");
+        softTextures[1].load("img/dicaprioLaugh.png");
+        glGenTextures(1, &softTexture);
+        GLState.bindTexture(GL_TEXTURE_2D, softTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, softWidth, softHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glGenFramebuffers(1, &softFramebuffer);
+        GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, softFramebuffer);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, softTexture, 0);
+    }
+
+    // view, projection and time live in one uniform block every program
+    // shares, written once per frame instead of once per program
+    UniformBuffer<CameraBlock> cameraBuffer;
+    cameraBuffer.init(CAMERA_BLOCK_BINDING);
+    CameraBlock cameraBlock;
+
 	glm::mat4 trans = glm::mat4(1.0f);
 
     // orthographic projection matrix, which defines the clipping space
@@ -207,29 +516,73 @@ int main() {
     // arg2, aspect ratio
     // arg3, near plane of frustum
     // arg4, far plane of frustum
-    glm::mat4 projection = glm::perspective((float)(M_PI / 4), (float)width / (float)height, 0.1f, 100.0f);
+    glm::mat4 projection = glm::perspective((float)(M_PI / 4), (float)window->width / (float)window->height, 0.1f, 100.0f);
 
     glm::mat4 model = glm::mat4(1.0f);
 
     //glm::mat4 view = glm::mat4(1.0f);
     //view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f));
 
-    glEnable(GL_DEPTH_TEST);
+    GLState.enable(GL_DEPTH_TEST);
 
     glm::mat4 view;
     view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), 
   		               glm::vec3(0.0f, 0.0f, 0.0f), 
   		               glm::vec3(0.0f, 1.0f, 0.0f));
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!benchmarkPath)
+        window->captureCursor();
 
     yaw = -90.0f;
     glm::vec3 direction;
 
+    // benchmarks run on simulated time and must not depend on how fast the
+    // textures happen to decode, so everything is resident before frame 0
+    BenchmarkRecorder benchmark;
+    GpuFrameTimer gpuTimer;
+    if (benchmarkPath) {
+        textureLoader.waitAll();
+        gpuTimer.init();
+    }
+    GpuProfiler gpuProfiler;
+    gpuProfiler.enabled = gpuProfilePath != NULL;
+    // the passes of a frame are declared every frame; the render targets
+    // and framebuffers behind them are pooled across frames
+    FrameGraph frameGraph;
+    frameGraph.profiler = &gpuProfiler;
+
+    // setup's uploads, reflection and state priming aren't per-frame work
+    GL_TRACE_BEGIN();
+    GLState.skipped = 0;
+
     /* RENDER LOOP */
-    while (!glfwWindowShouldClose(window)) {
-        // input
-        processInput(window);
+    while (!window->shouldClose()) {
+        PROFILE_ZONE("frame");
+        double frameStart = window->time();
+        float currentFrame;
+        if (benchmarkPath) {
+            // scripted camera, time advances by exactly fixedDelta per frame
+            currentFrame = window->frameCount * fixedDelta;
+            deltaTime = fixedDelta;
+            CameraKey key = cameraPath.sample(currentFrame);
+            cameraPos = key.position;
+            yaw = key.yaw;
+            pitch = key.pitch;
+            fov = key.fov;
+            gpuTimer.begin();
+        } else {
+            currentFrame = window->time();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+        }
+
+        // input; a benchmark only listens for escape, moving would change the run
+        if (benchmarkPath) {
+            if (window->keyPressed(GLFW_KEY_ESCAPE))
+                window->requestClose();
+        } else {
+            processInput(window);
+        }
 
         direction.x = cos(glm::radians(yaw) * cos(glm::radians(pitch)));
         direction.y = sin(glm::radians(pitch));
@@ -237,92 +590,435 @@ int main() {
         cameraFront = glm::normalize(direction);
         projection = glm::perspective(glm::radians(fov), 800.0f / 600.0f, 0.1f, 100.0f);
 
-        // render
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // bind textures on corresponding texture units
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-        
         //float timeValue = glfwGetTime();
         //trans = glm::rotate(trans, (float) (M_PI / 600), glm::vec3(1.0, 0.0, 0.0));
         //trans = glm::scale(trans, glm::vec3((sin(timeValue) / 400) + 1, (sin(timeValue) / 400) + 1, 1.0));
 
         model = glm::rotate(model, (float) (M_PI / 600), glm::vec3(0.5f, 1.0f, 0.0f));
-        int modelLoc = glGetUniformLocation(ourShader.ID, "model");
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        int viewLoc = glGetUniformLocation(ourShader.ID, "view");
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        int projLoc = glGetUniformLocation(ourShader.ID, "projection");
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        unsigned int transformLoc = glGetUniformLocation(ourShader.ID, "transform");
-        glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
 
         view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        cameraBlock.view = view;
+        cameraBlock.projection = projection;
+        cameraBlock.viewProjection = projection * view;
+        cameraBlock.cameraPosition = glm::vec4(cameraPos, 1.0f);
+        cameraBlock.time = currentFrame;
+        if (streaming) {
+            streamBuffer.beginFrame();
+            cameraBuffer.update(cameraBlock, streamBuffer);
+        } else {
+            cameraBuffer.update(cameraBlock);
+        }
+        if (culling && (software || renderPath != PATH_INSTANCED))
+            visibleCount = FrustumCuller::cullParallel(jobs, Frustum::fromMatrix(cameraBlock.viewProjection), cubeBounds, visible);
+        visibleTotal += visibleCount;
+
+        // render: declare the passes and what they read and write, the graph
+        // orders them, drops unused ones and hands out pooled render targets
+        frameGraph.reset();
+        frameGraph.setExtent(window->width, window->height);
+        FrameResource backbuffer = frameGraph.importFramebuffer("window", window->framebuffer());
+        FrameResource diffuseTexture = frameGraph.importTexture("texture1", textureLoader.texture(texture1));
+        FrameResource overlayTexture = frameGraph.importTexture("texture2", textureLoader.texture(texture2));
+        FrameResource camera = frameGraph.importBuffer("camera", cameraBuffer.ID);
+        // the cubes go straight to the window unless something post-processes them
+        FrameResource sceneColor = backbuffer, sceneDepth = backbuffer;
+        if (bloom) {
+            RenderTargetDesc color;
+            sceneColor = frameGraph.createTexture("scene color", color);
+            RenderTargetDesc depth;
+            depth.format = GL_DEPTH_COMPONENT24;
+            sceneDepth = frameGraph.createTexture("scene depth", depth);
+        }
+
+        frameGraph.addPass("clear", [&]() {
+            GLState.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }).write(sceneColor).write(sceneDepth);
+
+        // upload whatever the decode workers finished since last frame
+        frameGraph.addPass("texture upload", [&]() {
+            textureLoader.upload();
+        }).write(diffuseTexture).write(overlayTexture).keep();
+
+        // render containers
+        frameGraph.addPass("cubes", [&]() {
+            PROFILE_ZONE("draw cubes");
+            GLState.enable(GL_DEPTH_TEST);
+            // bind textures on corresponding texture units (GLState drops it when nothing changed)
+            GLState.bindTextureUnit(0, GL_TEXTURE_2D, textureLoader.texture(texture1));
+            GLState.bindTextureUnit(1, GL_TEXTURE_2D, textureLoader.texture(texture2));
+            if (software) {
+                if (window->width != softWidth || window->height != softHeight) {
+                    softWidth = window->width;
+                    softHeight = window->height;
+                    softRasterizer.resize(softWidth, softHeight);
+                    GLState.bindTexture(GL_TEXTURE_2D, softTexture);
+                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, softWidth, softHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                }
+                // what the per-object path draws, shaded like ourShader
+                softRasterizer.setViewProjection(cameraBlock.viewProjection);
+                softRasterizer.setTransform(trans);
+                for (size_t i = 0; i < visibleCount; i++) {
+                    const Instance &cube = cubes[visible[i]];
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, cube.position);
+                    model = glm::rotate(model, cube.angle + cubeSpin * currentFrame, cube.axis);
+                    model = glm::scale(model, glm::vec3(cube.scale));
+                    softRasterizer.draw(cubeData, model, &softTextures[0], &softTextures[1]);
+                }
+                softRasterizer.render(jobs);
+                softTrianglesTotal += softRasterizer.triangleCount();
+
+                GLState.bindTexture(GL_TEXTURE_2D, softTexture);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, softRasterizer.stride());
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, softWidth, softHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                                softRasterizer.colorBuffer());
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+                GLState.bindFramebuffer(GL_READ_FRAMEBUFFER, softFramebuffer);
+                GLState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, frameGraph.framebuffer());
+                glBlitFramebuffer(0, 0, softWidth, softHeight, 0, 0, softWidth, softHeight,
+                                  GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            } else if (renderPath == PATH_INSTANCED) {
+                // every cube in one draw, the shader builds each model matrix
+                instancedShader.use();
+                instancedSpinUniform.set(cubeSpin);
+                cubeRenderer.drawElements(GL_TRIANGLES, cubeMesh.indexCount, cubeMesh.indexType, 0);
+            } else if (renderPath == PATH_OBJECT_DATA || renderPath == PATH_INDIRECT) {
+                // one upload for all the matrices, then every object drawn by
+                // instance and looking its own up. Pyramids are the odd cubes,
+                // grouped after the rest so each mesh is one command.
+                if (renderPath == PATH_INDIRECT)
+                    cubeObjects = std::stable_partition(visible.begin(), visible.begin() + visibleCount,
+                                                        [](uint32_t i) { return i % 2 == 0; }) - visible.begin();
+                else
+                    cubeObjects = visibleCount;
+                jobs.parallelFor(0, visibleCount, jobs.grainFor(visibleCount), [&](size_t begin, size_t end) {
+                    PROFILE_ZONE("fill objects");
+                    for (size_t i = begin; i < end; i++) {
+                        const Instance &cube = cubes[visible[i]];
+                        glm::mat4 model = glm::mat4(1.0f);
+                        model = glm::translate(model, cube.position);
+                        model = glm::rotate(model, cube.angle + cubeSpin * currentFrame, cube.axis);
+                        model = glm::scale(model, glm::vec3(cube.scale));
+                        objects[i].model = model;
+                        unsigned int material = useAtlas ? visible[i] % spriteCount : i < cubeObjects ? 0 : 1;
+                        objects[i].material = glm::uvec4(material, 0, 0, 0);
+                    }
+                });
+                if (streaming)
+                    objectBuffer.update(objects.data(), visibleCount, streamBuffer);
+                else
+                    objectBuffer.update(objects.data(), visibleCount);
+                objectBuffer.bind();
+                objectShader.use();
+                if (useAtlas)
+                    GLState.bindTextureUnit(0, GL_TEXTURE_2D, spriteAtlas.texture);
+                if (renderPath == PATH_OBJECT_DATA) {
+                    meshArena.drawInstanced(cubeHandle, (GLsizei)visibleCount);
+                } else {
+                    drawBuilder.clear();
+                    drawBuilder.add(cubeHandle.range, 0, (GLuint)cubeObjects);
+                    drawBuilder.add(pyramidHandle.range, (GLuint)cubeObjects, (GLuint)(visibleCount - cubeObjects));
+                    drawBuilder.submit(meshArena, baseObjectLocation);
+                }
+            } else if (renderPath == PATH_QUEUE) {
+                // key every draw by program, texture set, VAO and distance, then
+                // draw in key order: opaque grouped by state front to back, then
+                // the translucent ones back to front over them
+                renderQueue.clear();
+                for (size_t i = 0; i < visibleCount; i++) {
+                    uint32_t c = visible[i];
+                    unsigned int textureSet = (c / 2) % 2;
+                    float depth = glm::length(cubes[c].position - cameraPos) / 100.0f;
+                    if (c % 7 == 3)
+                        renderQueue.push(RenderKey::translucent(0, translucentShader.ID, textureSet, meshArena.VAO, depth), c);
+                    else
+                        renderQueue.push(RenderKey::opaque(0, ourShader.ID, textureSet, meshArena.VAO, depth), c);
+                }
+                renderQueue.sort();
+
+                GLuint textureSets[2][2] = {
+                    { textureLoader.texture(texture1), textureLoader.texture(texture2) },
+                    { textureLoader.texture(texture2), textureLoader.texture(texture1) }
+                };
+                ourShader.use();
+                transformUniform.set(trans);
+                translucentShader.use();
+                translucentTransformUniform.set(trans);
+                bool blending = false;
+                for (const RenderItem &item : renderQueue.items()) {
+                    uint32_t c = item.payload;
+                    const Instance &cube = cubes[c];
+                    if (RenderKey::isTranslucent(item.key) && !blending) {
+                        GLState.enable(GL_BLEND);
+                        GLState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                        GLState.depthMask(false);
+                        blending = true;
+                    }
+                    const GLuint *textures = textureSets[(c / 2) % 2];
+                    GLState.bindTextureUnit(0, GL_TEXTURE_2D, textures[0]);
+                    GLState.bindTextureUnit(1, GL_TEXTURE_2D, textures[1]);
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, cube.position);
+                    model = glm::rotate(model, cube.angle + cubeSpin * currentFrame, cube.axis);
+                    model = glm::scale(model, glm::vec3(cube.scale));
+                    if (blending) {
+                        translucentShader.use();
+                        translucentModelUniform.set(model);
+                    } else {
+                        ourShader.use();
+                        modelUniform.set(model);
+                    }
+                    meshArena.draw(c % 2 ? pyramidHandle : cubeHandle);
+                }
+                if (blending) {
+                    GLState.disable(GL_BLEND);
+                    GLState.depthMask(true);
+                }
+            } else {
+                ourShader.use();
+                modelUniform.set(model);
+                transformUniform.set(trans);
+                for (size_t i = 0; i < visibleCount; i++) {
+                    const Instance &cube = cubes[visible[i]];
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, cube.position);
+                    model = glm::rotate(model, cube.angle + cubeSpin * currentFrame, cube.axis);
+                    model = glm::scale(model, glm::vec3(cube.scale));
+                    modelUniform.set(model);
+
+                    meshArena.draw(cubeHandle);
+                }
+            }
+        }).read(diffuseTexture).read(overlayTexture).read(camera).read(sceneColor).read(sceneDepth)
+          .write(sceneColor).write(sceneDepth);
+
+        // --bloom: highlights at half resolution, blurred one axis at a time;
+        // the bright and vertical blur targets don't overlap and share a texture
+        if (bloom) {
+            RenderTargetDesc half;
+            half.scale = 0.5f;
+            FrameResource bright = frameGraph.createTexture("bloom bright", half);
+            FrameResource blurX = frameGraph.createTexture("bloom blur x", half);
+            FrameResource blurY = frameGraph.createTexture("bloom blur y", half);
+            frameGraph.addPass("bloom bright", [&, sceneColor]() {
+                GLState.disable(GL_DEPTH_TEST);
+                brightShader.use();
+                GLState.bindTextureUnit(0, GL_TEXTURE_2D, frameGraph.texture(sceneColor));
+                GLState.bindVertexArray(postVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }).read(sceneColor).write(bright);
+            frameGraph.addPass("bloom blur x", [&, bright, blurX]() {
+                blurShader.use();
+                blurStepUniform.set(glm::vec2(1.0f / frameGraph.width(bright), 0.0f));
+                GLState.bindTextureUnit(0, GL_TEXTURE_2D, frameGraph.texture(bright));
+                GLState.bindVertexArray(postVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }).read(bright).write(blurX);
+            frameGraph.addPass("bloom blur y", [&, blurX, blurY]() {
+                blurShader.use();
+                blurStepUniform.set(glm::vec2(0.0f, 1.0f / frameGraph.height(blurX)));
+                GLState.bindTextureUnit(0, GL_TEXTURE_2D, frameGraph.texture(blurX));
+                GLState.bindVertexArray(postVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }).read(blurX).write(blurY);
+            frameGraph.addPass("composite", [&, sceneColor, blurY]() {
+                GLState.disable(GL_DEPTH_TEST);
+                compositeShader.use();
+                GLState.bindTextureUnit(0, GL_TEXTURE_2D, frameGraph.texture(sceneColor));
+                GLState.bindTextureUnit(1, GL_TEXTURE_2D, frameGraph.texture(blurY));
+                GLState.bindVertexArray(postVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }).read(sceneColor).read(blurY).write(backbuffer);
+        }
+
+        gpuProfiler.beginFrame();
+        frameGraph.compile();
+        frameGraph.execute();
+        gpuProfiler.endFrame();
+        if (streaming)
+            streamBuffer.endFrame();
+
+        frameCapture.capture(window->framebuffer(), window->width, window->height);
+
+        // swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        if (screenshotPath && window->frameCount + 1 == frameLimit)
+            window->saveScreenshot(screenshotPath);
+        if (benchmarkPath)
+            gpuTimer.end();
+        {
+            PROFILE_ZONE("swap");
+            window->swapBuffers();
+        }
+        GL_TRACE_FRAME();
+        window->pollEvents();
 
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // render container
-        ourShader.use();
-        glBindVertexArray(VAO);
-				for (unsigned int i = 0; i < 10; i++) {
-					glm::mat4 model = glm::mat4(1.0f);
-					model = glm::translate(model, cubePositions[i]);
-					model = glm::rotate(model, (float) ((M_PI / 10) * glfwGetTime()), glm::vec3(1.0f, 0.3f, 0.5f));
-					ourShader.setMat4("model", model);
-        
-					glDrawArrays(GL_TRIANGLES, 0, 36);
-				}
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (benchmarkPath) {
+            benchmark.addCpuFrame((window->time() - frameStart) * 1000.0);
+            gpuTimer.collect();
+        }
+    }
+
+    frameCapture.finish();
+
+    if (ProgramCache::enabled)
+        std::cout << "program cache: " << ProgramCache::hits << " hits, " << ProgramCache::misses << " misses" << std::endl;
+
+#ifdef GL_TRACE
+    GLTrace::print(GLTrace::startup, 1, 12, "startup");
+    GLTrace::print(GLTrace::total, GLTrace::frames);
+    if (GLTrace::frames) {
+        double frames = (double)GLTrace::frames;
+        benchmark.counters.push_back({ "gl_calls", GLTrace::total.totalCalls / frames });
+        benchmark.counters.push_back({ "gl_draw_calls", GLTrace::total.drawCalls / frames });
+        benchmark.counters.push_back({ "gl_triangles", GLTrace::total.triangles / frames });
+        benchmark.counters.push_back({ "gl_state_changes", GLTrace::total.stateChanges / frames });
+        benchmark.counters.push_back({ "gl_bytes_uploaded", GLTrace::total.bytesUploaded / frames });
+        benchmark.counters.push_back({ "gl_state_skipped", GLState.skipped / frames });
+        benchmark.counters.push_back({ "gl_get_uniform_location", GLTrace::total.calls[GLTRACE_glGetUniformLocation] / frames });
+    }
+    benchmark.counters.push_back({ "gl_startup_calls", (double)GLTrace::startup.totalCalls });
+#endif
+    if (benchmarkPath) {
+        gpuTimer.flush();
+        benchmark.info.push_back({ "camera_path", benchmarkPath });
+        const char *pathNames[] = { "per-object", "instanced", "objects", "indirect", "queue" };
+        benchmark.info.push_back({ "render_path", software ? "software" : pathNames[renderPath] });
+        benchmark.info.push_back({ "cubes", std::to_string(cubeCount) });
+        benchmark.info.push_back({ "resolution", std::to_string(window->width) + "x" + std::to_string(window->height) });
+        benchmark.info.push_back({ "threads", std::to_string(jobs.threadCount()) });
+        benchmark.info.push_back({ "culling", culling && (software || renderPath != PATH_INSTANCED) ? FrustumCuller::name(FrustumCuller::best()) : "off" });
+        if (window->frameCount)
+            benchmark.counters.push_back({ "visible_objects", visibleTotal / window->frameCount });
+        benchmark.info.push_back({ "streaming", !streaming ? "off" : streamBuffer.persistent() ? "persistent" : "mapped" });
+        if (streaming && window->frameCount) {
+            benchmark.counters.push_back({ "stream_bytes", (double)streamBuffer.bytesAllocated / window->frameCount });
+            benchmark.counters.push_back({ "stream_stalls", (double)streamBuffer.stallCount() });
+        }
+        if (software) {
+            benchmark.info.push_back({ "soft_kernel", SoftRasterizer::kernelName() });
+            if (window->frameCount)
+                benchmark.counters.push_back({ "soft_triangles", softTrianglesTotal / window->frameCount });
+        }
+        if (capturePath) {
+            benchmark.info.push_back({ "capture", frameCapture.formatName() });
+            benchmark.counters.push_back({ "capture_frames", (double)frameCapture.framesWritten() });
+            benchmark.counters.push_back({ "capture_stalls", (double)frameCapture.stallCount() });
+        }
+        benchmark.info.push_back({ "bloom", bloom ? "on" : "off" });
+        benchmark.info.push_back({ "atlas", useAtlas ? "on" : "off" });
+        benchmark.info.push_back({ "program_cache", ProgramCache::available() ? "on" : "off" });
+        benchmark.counters.push_back({ "program_cache_hits", (double)ProgramCache::hits });
+        benchmark.counters.push_back({ "program_cache_misses", (double)ProgramCache::misses });
+        if (renderPath == PATH_INDIRECT)
+            benchmark.info.push_back({ "draw_submit", DrawBuilder::indirect() ? "multi-draw" : "fallback" });
+        benchmark.counters.push_back({ "graph_passes", (double)frameGraph.passCount() });
+        benchmark.counters.push_back({ "graph_culled_passes", (double)frameGraph.culledCount() });
+        benchmark.counters.push_back({ "graph_targets", (double)frameGraph.targetCount() });
+        benchmark.counters.push_back({ "graph_target_bytes", (double)frameGraph.targetBytes() });
+        benchmark.counters.push_back({ "graph_transient_bytes", (double)frameGraph.transientBytes() });
+        benchmark.info.push_back({ "dt", std::to_string(fixedDelta) });
+        benchmark.info.push_back({ "renderer", (const char *)glGetString(GL_RENDERER) });
+        benchmark.print(gpuTimer.results());
+        benchmark.write(benchmarkOut, gpuTimer.results());
+        gpuTimer.destroy();
+    }
+    if (cpuTracePath)
+        CpuProfiler::writeChromeTrace(cpuTracePath);
+    if (gpuProfilePath) {
+        gpuProfiler.flush();
+        gpuProfiler.print();
+        gpuProfiler.dump(gpuProfilePath);
+        gpuProfiler.destroy();
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    cubeMesh.destroy();
+    meshArena.destroy();
+    cameraBuffer.destroy();
+    if (spriteAtlas.texture) {
+        GLState.textureDeleted(spriteAtlas.texture);
+        glDeleteTextures(1, &spriteAtlas.texture);
+    }
+    if (streaming)
+        streamBuffer.destroy();
+    if (renderPath == PATH_OBJECT_DATA || renderPath == PATH_INDIRECT)
+        objectBuffer.destroy();
+    if (renderPath == PATH_INDIRECT)
+        drawBuilder.destroy();
+    frameGraph.destroy();
+    if (bloom) {
+        GLState.vertexArrayDeleted(postVAO);
+        glDeleteVertexArrays(1, &postVAO);
+    }
+    if (software) {
+        GLState.framebufferDeleted(softFramebuffer);
+        GLState.textureDeleted(softTexture);
+        glDeleteFramebuffers(1, &softFramebuffer);
+        glDeleteTextures(1, &softTexture);
+    }
+    GLState.bufferDeleted(cubeRenderer.VBO);
+    glDeleteBuffers(1, &cubeRenderer.VBO);
 
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    glfwTerminate();
+    // release the context (and with GLFW, all previously allocated GLFW resources)
+    delete window;
     return 0;
 }
 
+// the first positionCount cubes are the hand placed ones; the rest fill a
+// jittered grid that grows with the count, so any size from 10 to millions works
+std::vector<Instance> buildCubeField(const glm::vec3 *positions, size_t positionCount, size_t count) {
+    std::vector<Instance> cubes(count);
+    size_t side = (size_t)ceil(cbrt((double)count));
+    const float spacing = 2.5f;
+    const float half = 0.5f * spacing * (float)(side - 1);
+    unsigned int seed = 1;
+    // small deterministic LCG so every run (and every benchmark) sees the same field
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1 << 24);
+    };
+    for (size_t i = 0; i < count; i++) {
+        Instance &cube = cubes[i];
+        cube.scale = 1.0f;
+        cube.axis = glm::vec3(1.0f, 0.3f, 0.5f);
+        cube.angle = 0.0f;
+        if (i < positionCount) {
+            cube.position = positions[i];
+            continue;
+        }
+        size_t cell = i - positionCount;
+        glm::vec3 jitter(random() - 0.5f, random() - 0.5f, random() - 0.5f);
+        cube.position = glm::vec3((float)(cell % side) * spacing - half,
+                                  (float)((cell / side) % side) * spacing - half,
+                                  -5.0f - (float)(cell / (side * side)) * spacing) + jitter;
+        cube.axis = glm::vec3(random() + 0.1f, random(), random());
+        cube.angle = random() * 6.2831853f;
+    }
+    return cubes;
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void processInput(GLFWwindow *window) {
+void processInput(Window *window) {
     const float cameraSpeed = 2.5f * deltaTime;
 
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
+    if (window->keyPressed(GLFW_KEY_ESCAPE))
+        window->requestClose();
     
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (window->keyPressed(GLFW_KEY_W))
         cameraPos += cameraSpeed * cameraFront;
 
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (window->keyPressed(GLFW_KEY_S))
         cameraPos -= cameraSpeed * cameraFront;
 
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (window->keyPressed(GLFW_KEY_A))
         cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (window->keyPressed(GLFW_KEY_D))
         cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 }
 
-// glfw: whenever the window size changed (by OS or user resize) this callback function executes
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    // make sure the viewport matches the new window dimensions; note that width and 
-    // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
-}
-
-void mouseCallback(GLFWwindow * window, double xpos, double ypos) {
+void mouseCallback(double xpos, double ypos) {
     if (firstMouse) {
         lastX = xpos;
         lastY = ypos;
@@ -345,7 +1041,7 @@ void mouseCallback(GLFWwindow * window, double xpos, double ypos) {
     if (pitch < -89.0f) pitch = -89.0f;
 }
 
-void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
+void scrollCallback(double xoffset, double yoffset) {
     fov -= (float)yoffset;
     if (fov < 1.0f)
         fov = 1.0f;
@@ -0,0 +1,22 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+flat in uint Material;
+
+#ifdef ATLAS
+// TexCoord is already remapped into the object's sprite
+uniform sampler2D atlas;
+#else
+uniform sampler2D texture1;
+uniform sampler2D texture2;
+#endif
+
+void main() {
+#ifdef ATLAS
+	FragColor = texture(atlas, TexCoord);
+#else
+	// material 0 is the container, 1 the second texture
+	FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), Material == 1u ? 1.0f : 0.0f);
+#endif
+}
@@ -0,0 +1,84 @@
+#version 330 core
+// OBJECT_SSBO and DRAW_PARAMETERS are defined by ObjectBuffer::defines() when
+// the context has them; see include/object_buffer.h
+#ifdef OBJECT_SSBO
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
+#ifdef DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+flat out uint Material;
+
+#ifdef ATLAS
+// with ATLAS the material picks a sprite: its uvMin in xy and uvMax in zw,
+// see AtlasRegion in include/atlas.h
+uniform vec4 spriteRects[ATLAS_SPRITES];
+#endif
+
+// shared by every program, see CameraBlock in include/uniform_blocks.h
+layout (std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+	float time;
+};
+
+struct ObjectData {
+	mat4 model;
+	uvec4 material;
+};
+
+#ifdef OBJECT_SSBO
+layout (std430) readonly buffer Objects
+{
+	ObjectData objects[];
+};
+
+ObjectData fetchObject(int index) {
+	return objects[index];
+}
+#else
+// the same bytes as five RGBA32F texels per object
+uniform samplerBuffer objectTexels;
+
+ObjectData fetchObject(int index) {
+	int texel = index * 5;
+	ObjectData object;
+	object.model = mat4(texelFetch(objectTexels, texel), texelFetch(objectTexels, texel + 1),
+	                    texelFetch(objectTexels, texel + 2), texelFetch(objectTexels, texel + 3));
+	object.material = floatBitsToUint(texelFetch(objectTexels, texel + 4));
+	return object;
+}
+#endif
+
+// the first object of a draw comes in as its base instance; without draw
+// parameters the application sets it as a uniform instead
+#ifdef DRAW_PARAMETERS
+int objectIndex() {
+	return gl_BaseInstanceARB + gl_InstanceID;
+}
+#else
+uniform int baseObject;
+
+int objectIndex() {
+	return baseObject + gl_InstanceID;
+}
+#endif
+
+void main() {
+	ObjectData object = fetchObject(objectIndex());
+	gl_Position = viewProjection * object.model * vec4(aPos, 1.0);
+#ifdef ATLAS
+	vec4 sprite = spriteRects[object.material.x];
+	TexCoord = mix(sprite.xy, sprite.zw, aTexCoord);
+#else
+	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+#endif
+	Material = object.material.x;
+}
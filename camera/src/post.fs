@@ -0,0 +1,35 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+// the bloom chain, one program per define: BRIGHT keeps what is above the
+// threshold, BLUR is one direction of a separable 9 tap gaussian and the
+// default composites the blurred highlights over the scene
+uniform sampler2D source;
+#if defined(BRIGHT)
+uniform float threshold;
+#elif defined(BLUR)
+uniform vec2 texelStep;
+const float weights[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+#else
+uniform sampler2D bloom;
+uniform float intensity;
+#endif
+
+void main() {
+#if defined(BRIGHT)
+	vec3 color = texture(source, TexCoord).rgb;
+	float brightness = max(color.r, max(color.g, color.b));
+	FragColor = vec4(color * (max(brightness - threshold, 0.0) / max(brightness, 0.0001)), 1.0);
+#elif defined(BLUR)
+	vec3 sum = texture(source, TexCoord).rgb * weights[0];
+	for (int i = 1; i < 5; i++) {
+		sum += texture(source, TexCoord + texelStep * float(i)).rgb * weights[i];
+		sum += texture(source, TexCoord - texelStep * float(i)).rgb * weights[i];
+	}
+	FragColor = vec4(sum, 1.0);
+#else
+	FragColor = vec4(texture(source, TexCoord).rgb + intensity * texture(bloom, TexCoord).rgb, 1.0);
+#endif
+}
@@ -0,0 +1,10 @@
+#version 330 core
+// one triangle that covers the screen, drawn with glDrawArrays(GL_TRIANGLES, 0, 3)
+// and no vertex attributes
+out vec2 TexCoord;
+
+void main() {
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	TexCoord = corner;
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -5,7 +5,13 @@ in vec2 TexCoord;
 
 uniform sampler2D texture1;
 uniform sampler2D texture2;
+#ifdef TRANSLUCENT
+uniform float opacity;
+#endif
 
 void main() {
 	FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.0f);
+#ifdef TRANSLUCENT
+	FragColor.a *= opacity;
+#endif
 }
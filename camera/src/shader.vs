@@ -4,12 +4,20 @@ layout (location = 1) in vec2 aTexCoord;
 
 out vec2 TexCoord;
 
+// shared by every program, see CameraBlock in include/uniform_blocks.h
+layout (std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+	float time;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat4 transform;
 
 void main() {
-	gl_Position = projection * view * model * transform * vec4(aPos, 1.0);
+	gl_Position = viewProjection * model * transform * vec4(aPos, 1.0);
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
 }
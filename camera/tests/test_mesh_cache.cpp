@@ -0,0 +1,69 @@
+// checks averageCacheMissRatio (include/mesh.h) against meshes whose FIFO
+// behaviour is known exactly, and that optimizeVertexCache never makes a
+// mesh worse
+//
+// usage: test_mesh_cache ; exit status 1 if a check fails
+#include "../include/mesh.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static bool near(float a, float b)
+{
+    return fabsf(a - b) < 1e-5f;
+}
+
+// triangles of a w x h quad grid, rows in order
+static std::vector<unsigned int> grid(unsigned int w, unsigned int h)
+{
+    std::vector<unsigned int> indices;
+    for (unsigned int y = 0; y < h; y++) {
+        for (unsigned int x = 0; x < w; x++) {
+            unsigned int a = y * (w + 1) + x, b = a + 1, c = a + w + 1, d = c + 1;
+            indices.insert(indices.end(), { a, b, c, b, d, c });
+        }
+    }
+    return indices;
+}
+
+int main() {
+    // one triangle: three misses
+    check(near(averageCacheMissRatio({ 0, 1, 2 }, 3), 3.0f), "single triangle");
+    // no shared vertices at all
+    check(near(averageCacheMissRatio({ 0, 1, 2, 3, 4, 5 }, 6), 3.0f), "disjoint triangles");
+
+    // vertex 0 was loaded exactly cacheSize misses ago: a FIFO of 6 still has
+    // it, so the repeated triangle is free: 6 misses over 3 triangles
+    std::vector<unsigned int> edge = { 0, 1, 2, 3, 4, 5, 0, 1, 2 };
+    check(near(averageCacheMissRatio(edge, 6, 6), 2.0f), "reuse at exactly cacheSize misses hits");
+    // one entry less and the repeated triangle misses everything: 9 / 3
+    check(near(averageCacheMissRatio(edge, 6, 5), 3.0f), "reuse beyond cacheSize misses");
+
+    // a strip of quads (one row) reuses two vertices per quad: with any cache
+    // of at least 4 every vertex misses once, (2 * (w + 1)) / (2 * w)
+    std::vector<unsigned int> strip = grid(8, 1);
+    check(near(averageCacheMissRatio(strip, 18, 4), 18.0f / 16.0f), "quad strip, cache of 4");
+    check(near(averageCacheMissRatio(strip, 18, 16), 18.0f / 16.0f), "quad strip, cache of 16");
+
+    // the optimizer must not lose to the input order of a large grid
+    std::vector<unsigned int> field = grid(64, 64);
+    float before = averageCacheMissRatio(field, 65 * 65);
+    optimizeVertexCache(field, 65 * 65);
+    float after = averageCacheMissRatio(field, 65 * 65);
+    check(after <= before, "optimizeVertexCache improves a grid");
+    check(after < 0.8f, "optimized grid close to the 0.5 ideal");
+    printf("grid 64x64 acmr: %.3f in row order, %.3f optimized\n", before, after);
+
+    return failures == 0 ? 0 : 1;
+}
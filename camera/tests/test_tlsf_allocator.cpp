@@ -0,0 +1,65 @@
+// checks TlsfAllocator (include/tlsf_allocator.h): that largestFree() can
+// really be allocated, and that stale handles are ignored by free()
+//
+// usage: test_tlsf_allocator ; exit status 1 if a check fails
+#include "../include/tlsf_allocator.h"
+
+#include <cstdio>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+int main() {
+    // a size that is not a class boundary: rounding it up skips its own list
+    TlsfAllocator whole;
+    whole.init(1000);
+    check(whole.largestFree() == 1000, "fresh allocator offers all of it");
+    TlsfAllocation all = whole.allocate(1000);
+    check(all.valid() && all.offset == 0 && all.size == 1000, "allocate(largestFree()) succeeds");
+    check(whole.largestFree() == 0 && !whole.allocate(1).valid(), "full allocator refuses more");
+    whole.free(all);
+    check(whole.used() == 0 && whole.largestFree() == 1000, "freeing gives it all back");
+
+    // the same after fragmenting: whatever largestFree() says must fit
+    TlsfAllocator mixed;
+    mixed.init(5000);
+    std::vector<TlsfAllocation> ranges;
+    for (uint32_t size = 37; mixed.largestFree() >= size; size += 53)
+        ranges.push_back(mixed.allocate(size));
+    for (size_t i = 0; i < ranges.size(); i += 2)
+        mixed.free(ranges[i]);
+    uint32_t largest = mixed.largestFree();
+    check(largest > 0 && mixed.allocate(largest).valid(), "allocate(largestFree()) after fragmenting");
+
+    // freeing q twice after it was merged into p must not touch r
+    TlsfAllocator merged;
+    merged.init(30);
+    TlsfAllocation p = merged.allocate(10), q = merged.allocate(10), r = merged.allocate(10);
+    merged.free(p);
+    merged.free(q);
+    merged.free(q);
+    check(merged.used() == 10, "double free of a merged block is ignored");
+    check(merged.largestFree() == 20, "free list intact after a double free");
+    merged.free(r);
+    check(merged.used() == 0 && merged.largestFree() == 30, "everything merges back");
+
+    // a handle to a block that was handed out again belongs to the new owner
+    merged.init(30);
+    TlsfAllocation first = merged.allocate(10);
+    merged.free(first);
+    TlsfAllocation second = merged.allocate(10);
+    merged.free(first);
+    check(merged.used() == 10, "stale handle to a reused block is ignored");
+    merged.free(second);
+    check(merged.used() == 0, "the current handle still frees it");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// offline texture baker: decodes images once and writes .btex containers with
+// the final GL format and the whole mip chain (see include/texture_container.h)
+//
+// usage: bake_textures [--no-flip] <output dir> <image>...
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "../include/texture_container.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <filesystem>
+
+int main(int argc, char **argv) {
+    bool flip = true;
+    int arg = 1;
+    if (arg < argc && std::string(argv[arg]) == "--no-flip") {
+        flip = false;
+        arg++;
+    }
+    if (argc - arg < 2) {
+        std::cout << "usage: bake_textures [--no-flip] <output dir> <image>..." << std::endl;
+        return 1;
+    }
+    std::filesystem::path outputDir = argv[arg++];
+    std::error_code ec;
+    std::filesystem::create_directories(outputDir, ec);
+
+    // match the runtime loader, which flips on load so UVs start at the bottom
+    stbi_set_flip_vertically_on_load(flip);
+
+    int failures = 0;
+    for (; arg < argc; arg++) {
+        const char *input = argv[arg];
+        int width, height, channels;
+        if (!stbi_info(input, &width, &height, &channels)) {
+            std::cout << "skipping " << input << ": " << stbi_failure_reason() << std::endl;
+            failures++;
+            continue;
+        }
+        // RGB is stored as RGBA so the upload is a straight copy for the driver
+        int stored = channels == 3 ? 4 : channels;
+        unsigned char *pixels = stbi_load(input, &width, &height, &channels, stored);
+        if (!pixels) {
+            std::cout << "failed to decode " << input << ": " << stbi_failure_reason() << std::endl;
+            failures++;
+            continue;
+        }
+        std::filesystem::path output = outputDir / std::filesystem::path(input).stem();
+        output += ".btex";
+        if (writeBakedTexture(output.c_str(), pixels, (uint32_t)width, (uint32_t)height, (uint32_t)stored, flip)) {
+            std::cout << input << " -> " << output.string() << " (" << width << "x" << height
+                      << ", " << stored << " channels)" << std::endl;
+        } else {
+            std::cout << "failed to write " << output.string() << std::endl;
+            failures++;
+        }
+        stbi_image_free(pixels);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+// compares two benchmark result files written by bin/main --benchmark and
+// flags frame time regressions of the current run against a baseline
+//
+// usage: bench_compare [--threshold PCT] [--min-delta MS] <baseline.json> <current.json>
+//
+// a metric regresses when it is both more than PCT percent (default 5) and
+// more than MS milliseconds (default 0.05) slower than the baseline. Only runs
+// of the same scene compare: camera path, render path, cube count, time step,
+// post effects, resolution and frame count must match. The exit status is 1
+// if anything regressed, 2 if a file can't be read or the runs don't match
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <iostream>
+
+// just enough JSON for the result files: nested objects of numbers and
+// strings, flattened to "object.key" -> value
+static bool parseObject(const std::string &text, size_t &pos, const std::string &prefix, std::map<std::string, double> &out, std::map<std::string, std::string> &strings);
+
+static void skipSpace(const std::string &text, size_t &pos) {
+    while (pos < text.size() && isspace((unsigned char)text[pos]))
+        pos++;
+}
+
+static bool parseString(const std::string &text, size_t &pos, std::string &value) {
+    if (pos >= text.size() || text[pos] != '"')
+        return false;
+    value.clear();
+    for (pos++; pos < text.size() && text[pos] != '"'; pos++) {
+        if (text[pos] == '\\')
+            pos++;
+        if (pos < text.size())
+            value += text[pos];
+    }
+    pos++;
+    return pos <= text.size();
+}
+
+static bool parseObject(const std::string &text, size_t &pos, const std::string &prefix, std::map<std::string, double> &out, std::map<std::string, std::string> &strings) {
+    skipSpace(text, pos);
+    if (pos >= text.size() || text[pos] != '{')
+        return false;
+    pos++;
+    while (true) {
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == '}') {
+            pos++;
+            return true;
+        }
+        std::string key;
+        if (!parseString(text, pos, key))
+            return false;
+        skipSpace(text, pos);
+        if (pos >= text.size() || text[pos] != ':')
+            return false;
+        pos++;
+        skipSpace(text, pos);
+        if (pos >= text.size())
+            return false;
+        std::string name = prefix.empty() ? key : prefix + "." + key;
+        if (text[pos] == '{') {
+            if (!parseObject(text, pos, name, out, strings))
+                return false;
+        } else if (text[pos] == '"') {
+            if (!parseString(text, pos, strings[name]))
+                return false;
+        } else {
+            char *end;
+            double value = strtod(text.c_str() + pos, &end);
+            if (end == text.c_str() + pos)
+                return false;
+            out[name] = value;
+            pos = end - text.c_str();
+        }
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == ',')
+            pos++;
+    }
+}
+
+struct Results {
+    std::map<std::string, double> numbers;
+    std::map<std::string, std::string> strings;
+};
+
+static bool loadResults(const char *path, Results &out) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "can't read " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+    size_t pos = 0;
+    if (!parseObject(text, pos, "", out.numbers, out.strings)) {
+        std::cout << "can't parse " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    double threshold = 5.0, minDelta = 0.05;
+    const char *files[2];
+    int fileCount = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--min-delta") == 0 && i + 1 < argc)
+            minDelta = atof(argv[++i]);
+        else if (fileCount < 2)
+            files[fileCount++] = argv[i];
+    }
+    if (fileCount != 2) {
+        std::cout << "usage: bench_compare [--threshold PCT] [--min-delta MS] <baseline.json> <current.json>" << std::endl;
+        return 2;
+    }
+
+    Results baselineResults, currentResults;
+    if (!loadResults(files[0], baselineResults) || !loadResults(files[1], currentResults))
+        return 2;
+
+    // frame times of different scenes say nothing about each other; what may
+    // differ is how the same scene is rendered (threads, culling, streaming...)
+    static const char *sceneKeys[] = {
+        "camera_path", "render_path", "cubes", "dt", "bloom", "atlas", "resolution"
+    };
+    bool compatible = true;
+    for (const char *key : sceneKeys) {
+        bool inBaseline = baselineResults.strings.count(key) != 0, inCurrent = currentResults.strings.count(key) != 0;
+        if (inBaseline != inCurrent) {
+            printf("%s is only recorded in the %s, can't tell if the runs match\n", key, inBaseline ? "baseline" : "current run");
+            compatible = false;
+        } else if (inBaseline && baselineResults.strings[key] != currentResults.strings[key]) {
+            printf("%s differs: %s vs %s\n", key, baselineResults.strings[key].c_str(), currentResults.strings[key].c_str());
+            compatible = false;
+        }
+    }
+    if (baselineResults.numbers["frames"] != currentResults.numbers["frames"]) {
+        printf("frame count differs: %.0f vs %.0f\n", baselineResults.numbers["frames"], currentResults.numbers["frames"]);
+        compatible = false;
+    }
+    if (!compatible) {
+        printf("the runs aren't of the same scene, record a new baseline (make bench-baseline)\n");
+        return 2;
+    }
+    std::map<std::string, double> &baseline = baselineResults.numbers, &current = currentResults.numbers;
+
+    // max is one frame and mostly noise, so it is shown but never flagged
+    static const char *metrics[] = {
+        "cpu_ms.p50", "cpu_ms.p95", "cpu_ms.p99", "cpu_ms.max",
+        "gpu_ms.p50", "gpu_ms.p95", "gpu_ms.p99", "gpu_ms.max"
+    };
+    int regressions = 0;
+    printf("%-12s %12s %12s %9s\n", "metric", "baseline", "current", "change");
+    for (const char *metric : metrics) {
+        if (!baseline.count(metric) || !current.count(metric))
+            continue;
+        double before = baseline[metric], after = current[metric];
+        double change = before > 0.0 ? (after - before) / before * 100.0 : 0.0;
+        bool flagged = strstr(metric, ".max") == NULL && change > threshold && after - before > minDelta;
+        printf("%-12s %12.4f %12.4f %+8.1f%%%s\n", metric, before, after, change, flagged ? "  REGRESSION" : "");
+        if (flagged)
+            regressions++;
+    }
+    if (regressions) {
+        printf("%d metric(s) regressed by more than %.1f%%\n", regressions, threshold);
+        return 1;
+    }
+    printf("no regressions\n");
+    return 0;
+}
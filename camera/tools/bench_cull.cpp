@@ -0,0 +1,128 @@
+// micro-benchmark of the frustum culling kernels (include/frustum_cull.h) on
+// random spheres, checking that every kernel keeps the same spheres as the
+// scalar one
+//
+// usage: bench_cull [--spheres N] [--runs R] [--threads T]
+//   --spheres N  bounding spheres to cull (default 1000000)
+//   --runs R     timed calls per kernel, the best and the median are printed
+//                (default 50)
+//   --threads T  also time cullParallel() with the best kernel on T workers
+//                (default 0: don't)
+// a "read only" line times summing the sphere arrays, the floor memory
+// bandwidth puts under any kernel. The exit status is 1 if a kernel
+// disagrees with the scalar one
+#include "../include/frustum_cull.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// best and median of runs timed calls of cull, after one untimed warm-up call
+template <typename Cull>
+static void timeKernel(const char *name, int runs, size_t spheres, Cull cull) {
+    size_t visible = cull();
+    std::vector<double> times;
+    for (int run = 0; run < runs; run++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        cull();
+        times.push_back(millisecondsSince(start));
+    }
+    std::sort(times.begin(), times.end());
+    printf("%-12s best %7.3f ms  median %7.3f ms  %6.2f ns/sphere  %zu visible\n", name, times[0],
+           times[times.size() / 2], times[0] * 1e6 / (double)spheres, visible);
+}
+
+int main(int argc, char **argv) {
+    size_t count = 1000000;
+    int runs = 50;
+    unsigned int threads = 0;
+    for (int arg = 1; arg < argc; arg++) {
+        std::string option = argv[arg];
+        if (option == "--spheres" && arg + 1 < argc)
+            count = strtoul(argv[++arg], NULL, 10);
+        else if (option == "--runs" && arg + 1 < argc)
+            runs = std::max(1, atoi(argv[++arg]));
+        else if (option == "--threads" && arg + 1 < argc)
+            threads = (unsigned int)strtoul(argv[++arg], NULL, 10);
+        else {
+            std::cout << "usage: bench_cull [--spheres N] [--runs R] [--threads T]" << std::endl;
+            return 1;
+        }
+    }
+
+    // spheres scattered through a 200 unit cube around a camera at the
+    // origin looking down -z, roughly like the demo's field of cubes
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    BoundingSpheres spheres;
+    spheres.resize(count);
+    for (size_t i = 0; i < count; i++)
+        spheres.set(i, glm::vec3(position(random), position(random), position(random)), size(random));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::fromMatrix(projection * view);
+
+    std::vector<uint32_t> expected, visible;
+    size_t expectedCount = FrustumCuller::cull(frustum, spheres, expected, CULL_SCALAR);
+    expected.resize(expectedCount);
+    printf("%zu spheres, %zu visible, best kernel %s\n", count, expectedCount,
+           FrustumCuller::name(FrustumCuller::best()));
+
+    // what just reading the x, y, z and radius arrays costs; the sum goes to
+    // a volatile so the loop isn't hoisted out of the timing
+    volatile float readSink = 0.0f;
+    timeKernel("read only", runs, count, [&]() {
+#ifdef __SSE2__
+        __m128 sum = _mm_setzero_ps();
+        for (size_t i = 0; i < spheres.paddedSize(); i += 4)
+            sum = _mm_add_ps(sum, _mm_add_ps(_mm_add_ps(_mm_loadu_ps(&spheres.x[i]), _mm_loadu_ps(&spheres.y[i])),
+                                             _mm_add_ps(_mm_loadu_ps(&spheres.z[i]), _mm_loadu_ps(&spheres.radius[i]))));
+        readSink = readSink + _mm_cvtss_f32(sum);
+#else
+        float sum = 0.0f;
+        for (size_t i = 0; i < spheres.paddedSize(); i++)
+            sum += spheres.x[i] + spheres.y[i] + spheres.z[i] + spheres.radius[i];
+        readSink = readSink + sum;
+#endif
+        return (size_t)0;
+    });
+
+    bool failed = false;
+    for (int kernel = CULL_SCALAR; kernel <= (int)FrustumCuller::best(); kernel++) {
+        CullKernel cullKernel = (CullKernel)kernel;
+        size_t visibleCount = FrustumCuller::cull(frustum, spheres, visible, cullKernel);
+        if (visibleCount != expectedCount || !std::equal(expected.begin(), expected.end(), visible.begin())) {
+            printf("FAILED: %s keeps %zu spheres, scalar %zu\n", FrustumCuller::name(cullKernel), visibleCount,
+                   expectedCount);
+            failed = true;
+        }
+        timeKernel(FrustumCuller::name(cullKernel), runs, count, [&]() {
+            return FrustumCuller::cull(frustum, spheres, visible, cullKernel);
+        });
+    }
+    if (threads) {
+        JobSystem jobs(threads);
+        std::string name = std::string(FrustumCuller::name(FrustumCuller::best())) + " x" + std::to_string(threads);
+        size_t visibleCount = FrustumCuller::cullParallel(jobs, frustum, spheres, visible);
+        if (visibleCount != expectedCount || !std::equal(expected.begin(), expected.end(), visible.begin())) {
+            printf("FAILED: %s keeps %zu spheres, scalar %zu\n", name.c_str(), visibleCount, expectedCount);
+            failed = true;
+        }
+        timeKernel(name.c_str(), runs, count, [&]() {
+            return FrustumCuller::cullParallel(jobs, frustum, spheres, visible);
+        });
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+// offline atlas builder: packs small images into one baked texture (MaxRects)
+// and writes a remap table that TextureAtlas (include/atlas.h) reads back.
+//
+// usage: build_atlas [--mips M] [--padding P] [--max-size S] <output prefix> <image>...
+//   --mips M      mip levels beyond the base that must not bleed between
+//                 sprites (default 2); gutters and cell alignment are 2^M texels
+//   --padding P   extra transparent texels around each gutter (default 0)
+//   --max-size S  largest atlas edge to try (default 4096)
+// writes <output prefix>.btex and <output prefix>.atlas
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "../include/texture_container.h"
+#include "../include/atlas.h"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+struct Sprite {
+    std::string name;
+    int width, height;
+    unsigned char *pixels;
+    int cellWidth, cellHeight;
+    MaxRectsPacker::Rect cell;
+};
+
+static int roundUp(int value, int multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// try to place every sprite in a width x height bin, largest first
+static bool pack(std::vector<Sprite> &sprites, const std::vector<size_t> &order, int width, int height) {
+    MaxRectsPacker packer(width, height);
+    for (size_t i : order) {
+        if (!packer.insert(sprites[i].cellWidth, sprites[i].cellHeight, sprites[i].cell))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int mips = 2, padding = 0, maxSize = 4096;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        std::string option = argv[arg];
+        if (option == "--mips")
+            mips = std::max(0, atoi(argv[arg + 1]));
+        else if (option == "--padding")
+            padding = std::max(0, atoi(argv[arg + 1]));
+        else if (option == "--max-size")
+            maxSize = atoi(argv[arg + 1]);
+        else
+            break;
+    }
+    if (argc - arg < 2) {
+        std::cout << "usage: build_atlas [--mips M] [--padding P] [--max-size S] <output prefix> <image>..." << std::endl;
+        return 1;
+    }
+    std::string prefix = argv[arg++];
+    // a sprite edge stays at least one texel away from its neighbours down to level mips
+    const int align = 1 << mips;
+    const int gutter = align;
+
+    // loaded flipped like the runtime, so atlas row 0 is v = 0
+    stbi_set_flip_vertically_on_load(true);
+    std::vector<Sprite> sprites;
+    long long area = 0;
+    int largest = 0;
+    for (; arg < argc; arg++) {
+        Sprite sprite;
+        int channels;
+        sprite.pixels = stbi_load(argv[arg], &sprite.width, &sprite.height, &channels, 4);
+        if (!sprite.pixels) {
+            std::cout << "failed to decode " << argv[arg] << ": " << stbi_failure_reason() << std::endl;
+            return 1;
+        }
+        sprite.name = std::filesystem::path(argv[arg]).stem().string();
+        sprite.cellWidth = roundUp(sprite.width + 2 * (gutter + padding), align);
+        sprite.cellHeight = roundUp(sprite.height + 2 * (gutter + padding), align);
+        area += (long long)sprite.cellWidth * sprite.cellHeight;
+        largest = std::max(largest, std::max(sprite.cellWidth, sprite.cellHeight));
+        sprites.push_back(sprite);
+    }
+
+    std::vector<size_t> order(sprites.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        int sideA = std::max(sprites[a].cellWidth, sprites[a].cellHeight);
+        int sideB = std::max(sprites[b].cellWidth, sprites[b].cellHeight);
+        if (sideA != sideB)
+            return sideA > sideB;
+        return sprites[a].cellWidth * sprites[a].cellHeight > sprites[b].cellWidth * sprites[b].cellHeight;
+    });
+
+    // smallest power of two bin that holds everything, trying w = h then w = 2h
+    int width = 0, height = 0;
+    for (int size = 1; size <= maxSize && width == 0; size *= 2) {
+        if ((long long)size * size * 2 < area || size * 2 < largest)
+            continue;
+        if (size >= largest && (long long)size * size >= area && pack(sprites, order, size, size)) {
+            width = height = size;
+        } else if (size * 2 <= maxSize && pack(sprites, order, size * 2, size)) {
+            width = size * 2;
+            height = size;
+        }
+    }
+    if (width == 0) {
+        std::cout << "sprites don't fit in a " << maxSize << "x" << maxSize << " atlas" << std::endl;
+        return 1;
+    }
+
+    // copy each sprite into its cell and extrude its edge texels into the gutter
+    std::vector<unsigned char> atlas((size_t)width * height * 4, 0);
+    for (const Sprite &sprite : sprites) {
+        int originX = sprite.cell.x + padding + gutter;
+        int originY = sprite.cell.y + padding + gutter;
+        for (int y = -gutter; y < sprite.height + gutter; y++) {
+            int srcY = std::min(std::max(y, 0), sprite.height - 1);
+            for (int x = -gutter; x < sprite.width + gutter; x++) {
+                int srcX = std::min(std::max(x, 0), sprite.width - 1);
+                const unsigned char *src = sprite.pixels + ((size_t)srcY * sprite.width + srcX) * 4;
+                unsigned char *dst = atlas.data() + ((size_t)(originY + y) * width + originX + x) * 4;
+                std::copy(src, src + 4, dst);
+            }
+        }
+    }
+
+    std::string texturePath = prefix + ".btex";
+    std::string tablePath = prefix + ".atlas";
+    std::filesystem::path parent = std::filesystem::path(prefix).parent_path();
+    std::error_code ec;
+    if (!parent.empty())
+        std::filesystem::create_directories(parent, ec);
+    if (!writeBakedTexture(texturePath.c_str(), atlas.data(), width, height, 4, true, mips + 1)) {
+        std::cout << "failed to write " << texturePath << std::endl;
+        return 1;
+    }
+
+    FILE *table = fopen(tablePath.c_str(), "w");
+    if (!table) {
+        std::cout << "failed to write " << tablePath << std::endl;
+        return 1;
+    }
+    fprintf(table, "atlas %s %d %d %d\n", std::filesystem::path(texturePath).filename().c_str(), width, height, mips + 1);
+    for (const Sprite &sprite : sprites) {
+        int x = sprite.cell.x + padding + gutter;
+        int y = sprite.cell.y + padding + gutter;
+        fprintf(table, "sprite %s %d %d %d %d %.9g %.9g %.9g %.9g\n", sprite.name.c_str(), x, y, sprite.width, sprite.height,
+                (double)x / width, (double)y / height,
+                (double)(x + sprite.width) / width, (double)(y + sprite.height) / height);
+        stbi_image_free(sprite.pixels);
+    }
+    fclose(table);
+    std::cout << sprites.size() << " sprites -> " << texturePath << " (" << width << "x" << height
+              << ", " << mips + 1 << " levels), " << tablePath << std::endl;
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+
+// intrusive lock-free multi-producer single-consumer queue (Vyukov's design).
+// Any number of threads may push; only one thread may pop. Items derive from
+// MPSCNode and are owned by whoever popped them. Push is one atomic exchange
+// and never blocks; pop can briefly report empty while a push is half done.
+struct MPSCNode
+{
+    std::atomic<MPSCNode*> next{ nullptr };
+};
+
+template <typename T>
+class MPSCQueue
+{
+public:
+    MPSCQueue() : head(&stub), tail(&stub) {}
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // safe from any thread
+    // ------------------------------------------------------------------------
+    void push(T *item)
+    {
+        pushNode(static_cast<MPSCNode*>(item));
+    }
+    // consumer thread only, NULL if nothing is ready
+    // ------------------------------------------------------------------------
+    T *pop()
+    {
+        MPSCNode *first = tail;
+        MPSCNode *next = first->next.load(std::memory_order_acquire);
+        if (first == &stub)
+        {
+            if (!next)
+                return nullptr;
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            tail = next;
+            return static_cast<T*>(first);
+        }
+        // first is the last node; unless a producer is mid-push, requeue the
+        // stub behind it so first can be handed out
+        if (first != head.load(std::memory_order_acquire))
+            return nullptr;
+        pushNode(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (next)
+        {
+            tail = next;
+            return static_cast<T*>(first);
+        }
+        return nullptr;
+    }
+
+private:
+    std::atomic<MPSCNode*> head;
+    MPSCNode *tail;
+    MPSCNode stub;
+
+    void pushNode(MPSCNode *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        MPSCNode *prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+};
+#endif